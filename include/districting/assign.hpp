@@ -0,0 +1,56 @@
+#ifndef _ASSIGN_H
+#define _ASSIGN_H
+
+#include <vector>
+
+// population-capacitated assignment of n nodes to k given centers, the subproblem of the Hess
+// heuristics once the centers are fixed: min sum w[i][c(i)] s.t. c(j) = j for the centers and
+// the population of every district in [L, U]. No Gurobi; buffers are kept between solves,
+// so use one solver per thread
+class assignment_solver
+{
+private:
+  const std::vector<std::vector<double>>& w;
+  const std::vector<int>& population;
+  int L, U;
+  int n;
+
+  // min-cost flow node -> center -> sink in population units, nodes sent one after another along
+  // shortest paths; a path only visits centers, moving flow of some node from one center to the next,
+  // so it is found on the k centers with edge c -> c' the cheapest such move (via[c * k + c'])
+  std::vector<int> supply; // flow node -> graph node
+  std::vector<double> unit; // unit[t * k + c], cost per unit of population
+  std::vector<long long> flow; // flow[t * k + c]
+  std::vector<std::vector<int>> members; // flow nodes with flow into c, may hold stale entries
+  std::vector<double> move; // move[c * k + c']
+  std::vector<int> via;
+  std::vector<double> pi, dist; // potentials and distances on the centers
+  std::vector<int> pred; // center before c on the path, -1 after the source
+  std::vector<char> done;
+  std::vector<long long> lower, upper; // residual capacity below L and between L and U per center
+  std::vector<int> center_of; // graph node -> position in centers, -1 otherwise
+  std::vector<long long> load; // district populations
+  std::vector<double> price; // Lagrangian multipliers of the population bounds
+  std::vector<std::vector<int>> by_center; // non-center nodes per district, for swaps
+
+  void update_moves(int c, int k);
+  // fractional assignment of the LP relaxation rounded to the largest share; false if infeasible
+  bool solve_lp(const std::vector<int>& centers, std::vector<int>& assignment);
+  // best exchange of two nodes between districts by violation removed, @return the violation removed
+  long long swap(const std::vector<int>& centers, std::vector<int>& assignment);
+  // single node moves and swaps towards [L, U]; false if some district is still out of bounds
+  bool repair(const std::vector<int>& centers, std::vector<int>& assignment);
+  // assignments at subgradient prices of the population bounds, repaired; false if none feasible
+  bool lagrangian_repair(const std::vector<int>& centers, std::vector<int>& assignment);
+  // improving single node moves that keep the bounds
+  void improve(const std::vector<int>& centers, std::vector<int>& assignment);
+  long long violation(int c) const { return load[c] > U ? load[c] - U : (load[c] < L ? L - load[c] : 0); }
+public:
+  assignment_solver(const std::vector<std::vector<double>>& w_, const std::vector<int>& population_, int L_, int U_);
+  // assignment[i] is the center of node i, @return its objective or MYINFINITY if none was found
+  double solve(const std::vector<int>& centers, std::vector<int>& assignment);
+  // LP bound of the last solve
+  double lp_bound;
+};
+
+#endif
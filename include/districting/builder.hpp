@@ -0,0 +1,47 @@
+#ifndef _BUILDER_H
+#define _BUILDER_H
+
+#include <vector>
+#include <cstddef>
+
+#include "gurobi_c++.h"
+#include "districting/common.hpp"
+
+// constraint rows collected in CSR form and added to the model with one addConstrs call per chunk
+class row_builder
+{
+private:
+  GRBModel* model;
+  std::vector<std::size_t> start; // terms of row r are [start[r], start[r+1])
+  std::vector<GRBVar> var;
+  std::vector<double> coef;
+  std::vector<char> sense;
+  std::vector<double> rhs;
+  double constant; // constant terms of the current row
+public:
+  row_builder(GRBModel* model_) : model(model_), start(1, 0), constant(0.) {}
+  void add(GRBVar v, double c) { var.push_back(v); coef.push_back(c); }
+  // adds c * X(i,j): nothing if x_ij is fixed to 0, a constant if fixed to 1
+  void add_x(const hess_params& p, int i, int j, double c)
+  {
+    if (p.F->is_zero(i, j))
+      return;
+    if (p.F->is_one(i, j))
+      constant += c;
+    else
+      add(p.x[p.h(i, j)], c);
+  }
+  // closes the current row as <terms> [sense] rhs
+  void end(char sense_, double rhs_);
+  // adds the rows not added yet
+  void flush();
+  std::size_t size() const { return sense.size(); }
+};
+
+// sets the objective coefficients of column j of [p] to w[i][c], array attribute in one call
+void set_column_obj(GRBModel* model, const hess_params& p, int j, const std::vector<std::vector<double>>& w, int c);
+
+// sets the objective sum w_ij X(i,j) in one call, constants of x_ij fixed to 1 go to ObjCon
+void set_hess_obj(GRBModel* model, const hess_params& p, const std::vector<std::vector<double>>& w);
+
+#endif
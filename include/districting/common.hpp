@@ -1,24 +1,65 @@
 #ifndef __COMMON_H
 #define __COMMON_H
 
+#include <cstddef>
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include "gurobi_c++.h"
+#include "districting/fixing.hpp"
+
+// (i,j) -> number of the x_ij variable, -1 if there is none
+// columns without variables take no space, so an n x k restricted model needs n*k entries
+class var_index
+{
+private:
+  std::vector<int> col; // compact column of j, -1 if column j has no variables
+  std::vector<int> idx; // variable of (i,j) at i*nr_cols + col[j]
+  std::vector<int> var_i; // (var_i[v], var_j[v]) is the pair of variable v
+  std::vector<int> var_j;
+  std::size_t nr_cols;
+  std::size_t nr_vars;
+public:
+  var_index() : nr_cols(0), nr_vars(0) {}
+  // n rows, variables may only be added to [columns]
+  void reset(int n, const std::vector<int>& columns)
+  {
+    col.assign(n, -1);
+    nr_cols = 0;
+    for (int j : columns)
+      col[j] = static_cast<int>(nr_cols++);
+    idx.assign(static_cast<std::size_t>(n) * nr_cols, -1);
+    var_i.clear();
+    var_j.clear();
+    nr_vars = 0;
+  }
+  int add(int i, int j)
+  {
+    var_i.push_back(i);
+    var_j.push_back(j);
+    return idx[i * nr_cols + col[j]] = static_cast<int>(nr_vars++);
+  }
+  int operator()(int i, int j) const { return idx[i * nr_cols + col[j]]; }
+  bool has(int i, int j) const { return col[j] >= 0 && idx[i * nr_cols + col[j]] >= 0; }
+  std::size_t size() const { return nr_vars; }
+  int row(int v) const { return var_i[v]; }
+  int column(int v) const { return var_j[v]; }
+};
 
 struct hess_params
 {
   GRBVar* x;
-  std::vector<std::vector<bool>> F0;
-  std::vector<std::vector<bool>> F1;
-  std::unordered_map<int, int> h;
+  std::shared_ptr<fixing_matrix> F; // shared with the caller, not copied
+  var_index h;
   int n;
   int infty;
 };
 
 //hack
-#define IS_X(i,j) (!p.F0[i][j] && !p.F1[i][j])
-#define X_V(i,j) (p.x[p.h[p.n*i+j]])
-#define X(i,j) (p.F0[i][j]?GRBLinExpr(0.):(p.F1[i][j]?GRBLinExpr(1.):GRBLinExpr(X_V(i,j))))
+#define IS_X(i,j) (p.F->is_free(i,j))
+#define X_I(i,j) (p.h(i,j))
+#define X_V(i,j) (p.x[X_I(i,j)])
+#define X(i,j) (p.F->is_zero(i,j)?GRBLinExpr(0.):(p.F->is_one(i,j)?GRBLinExpr(1.):GRBLinExpr(X_V(i,j))))
 
 struct run_params
 {
@@ -31,6 +72,18 @@ struct run_params
   int k;
   std::string model;
   std::string ralg_hot_start;
+  int lagrange_threads; // concurrent line search steps in ralg
+  int cut_threads; // threads separating centers in the cut callback
+  int fixing_threads; // threads of the population-distance fixing
+  int heuristic_threads; // concurrent restarts of HessHeuristic and LocalSearch swaps
+  int heuristic_restarts; // restarts of HessHeuristic
+  int heuristic_batch; // restarts of HessHeuristic sharing one cutoff, their result does not depend on the threads
+  std::string checkpoint; // Lagrangian checkpoint file, none if empty
+  int checkpoint_interval; // seconds between checkpoints
+  bool resume; // continue from checkpoint
+  std::string ralg_trace; // per iteration trace of ralg (.csv or binary), none if empty
+  bool lagrange_shrink; // drop multipliers of centers that cannot beat UB during the Lagrangian
+  int lagrange_coarsen; // warm start from a graph with n/lagrange_coarsen nodes, off if <= 1
   FILE* output;
 };
 
@@ -46,4 +99,7 @@ struct pair_hash {
 
 #define MYINFINITY 1e20
 
+// x[i][j] is fixed to 0 if LB1[i][j] > UB + VarFixingEpsilon
+const double VarFixingEpsilon = 0.00001;
+
 #endif
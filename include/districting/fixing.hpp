@@ -0,0 +1,72 @@
+#ifndef _FIXING_H
+#define _FIXING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// fixings of the n x n assignment variables x_ij, two bit planes (fixed to 0, fixed to 1)
+// with 64-bit words per row; bit j%64 of word j/64 of row i is the pair (i,j)
+class fixing_matrix
+{
+private:
+  std::size_t n;
+  std::size_t words; // words per row
+  std::vector<uint64_t> zero;
+  std::vector<uint64_t> one;
+  uint64_t tail; // valid bits of the last word of a row
+  template <typename F>
+  static void for_bits(uint64_t m, std::size_t base, F f)
+  {
+    while (m)
+    {
+      f(static_cast<int>(base + __builtin_ctzll(m)));
+      m &= m - 1;
+    }
+  }
+public:
+  fixing_matrix(int n_ = 0) { resize(n_); }
+  // n x n, nothing fixed
+  void resize(int n_);
+  int size() const { return static_cast<int>(n); }
+
+  bool is_zero(int i, int j) const { return (zero[i * words + (j >> 6)] >> (j & 63)) & 1; }
+  bool is_one(int i, int j) const { return (one[i * words + (j >> 6)] >> (j & 63)) & 1; }
+  bool is_free(int i, int j) const { std::size_t w = i * words + (j >> 6); return !(((zero[w] | one[w]) >> (j & 63)) & 1); }
+  void fix_zero(int i, int j) { zero[i * words + (j >> 6)] |= uint64_t(1) << (j & 63); }
+  void fix_one(int i, int j) { one[i * words + (j >> 6)] |= uint64_t(1) << (j & 63); }
+  // fixes x_ij to 0 for j outside [columns], unfixes everything else
+  void restrict_columns(const std::vector<int>& columns);
+
+  // word w of row i with bits set for the free pairs
+  uint64_t free_word(int i, std::size_t w) const
+  {
+    std::size_t pos = i * words + w;
+    return ~(zero[pos] | one[pos]) & (w + 1 == words ? tail : ~uint64_t(0));
+  }
+  std::size_t nr_words() const { return words; }
+  // f(j) for the free / fixed to 1 columns j of row i, in increasing order
+  template <typename F>
+  void for_free(int i, F f) const
+  {
+    for (std::size_t w = 0; w < words; ++w)
+      for_bits(free_word(i, w), w << 6, f);
+  }
+  template <typename F>
+  void for_one(int i, F f) const
+  {
+    for (std::size_t w = 0; w < words; ++w)
+      for_bits(one[i * words + w], w << 6, f);
+  }
+  std::size_t count_zero() const;
+  std::size_t count_one() const;
+};
+
+class graph;
+
+// fixes x_ab to 0 when every a-b path weighs more than U in population (both ends included),
+// as no contiguous district can hold a and b then; rows in parallel on [nr_threads] threads,
+// returns the number of new fixings
+std::size_t fix_population_distance(fixing_matrix& F, graph* g, const std::vector<int>& population, int U, unsigned int nr_threads);
+
+#endif
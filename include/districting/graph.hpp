@@ -32,4 +32,14 @@ public:
 
 graph* from_dimacs(const char* fname); // don't forget to delete
 
+// arc (i, g->nb(i)[t]) is numbered off[i] + t, rev[a] is the opposite arc; valid until g changes
+struct arc_index
+{
+    std::vector<int> off; // n + 1 entries
+    std::vector<int> head;
+    std::vector<int> rev;
+    arc_index(graph* g);
+    int nr_arcs() const { return static_cast<int>(head.size()); }
+};
+
 #endif
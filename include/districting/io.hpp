@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include "districting/common.hpp"
+#include "districting/ralg.hpp"
 
 using namespace std;
 
@@ -21,5 +22,14 @@ int read_auto_int(const char*, int);
 void read_ralg_hot_start(const char* fname, double* x0, int dim);
 void dump_ralg_hot_start_fname(const char*, double* res, int dim, double opt);
 void dump_ralg_hot_start(const run_params& rp, double* res, int dim, double opt);
+// write r-algorithm state on coordinates [active] of the full multipliers [base], and Lagrangian bounds
+// to [fname] atomically (via a temporary file)
+bool dump_lagrange_checkpoint(const char* fname, const ralg_state& st, const vector<int>& active, const vector<double>& base,
+  double LB, const vector<vector<double>>& LB1);
+// read only the active coordinates of the checkpoint for n nodes
+bool peek_lagrange_checkpoint(const char* fname, unsigned int n, vector<int>& active);
+// fill [st] (buffers already allocated for [active]), [base], [LB] and [LB1] from [fname], false if missing or not matching
+bool read_lagrange_checkpoint(const char* fname, ralg_state& st, const vector<int>& active, vector<double>& base,
+  double& LB, vector<vector<double>>& LB1);
 int ffprintf(FILE* f, const char* arg, ...);
 #endif
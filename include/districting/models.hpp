@@ -2,6 +2,8 @@
 #define _MODELS_H
 
 #include <vector>
+#include <algorithm>
+#include <memory>
 #include "districting/common.hpp"
 #include "graph.hpp"
 #include "io.hpp"
@@ -9,59 +11,103 @@
 
 using namespace std;
 
-typedef const vector<vector<bool>> cvv;
 
 //auxilliary procedure
 double get_objective_coefficient(const vector<vector<int>>& dist, const vector<int>& population, int i, int j);
 
 // build hess model and return x variables
-hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, cvv& F0, cvv& F1);
+hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k,
+  const std::shared_ptr<fixing_matrix>& F);
 // constraints are organized in certain order to match Lagrangian
 hess_params build_hess_special(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k);
 // add MCF constraints to model with hess variables x
 void build_shir(GRBModel* model, hess_params& p, graph* g);
 void build_mcf(GRBModel* model, hess_params& p, graph* g);
+
+// flow formulation whose blocks are only added once a solution uses them
+class LazyFlow
+{
+protected:
+  hess_params& p;
+  graph* g;
+  // adds the missing blocks used by solution x (indexed like p.x, values > eps count), returns how many
+  virtual int add_blocks(GRBModel* model, const double* x, double eps) = 0;
+public:
+  int numRounds; // LP and MIP solves
+  int numBlocks; // blocks added lazily
+  LazyFlow(hess_params& p_, graph* g_) : p(p_), g(g_), numRounds(0), numBlocks(0) {}
+  virtual ~LazyFlow() {}
+  // LP rounds on the relaxation adding the blocks with positive x, then MIP solves until
+  // the incumbent only uses built blocks, within the model's TimeLimit overall
+  void optimize(GRBModel* model);
+};
+// MCF with commodities (a,b) added by LazyFlow::optimize, @return for optimize and delete
+LazyFlow* build_lmcf(GRBModel* model, hess_params& p, graph* g);
+// SHIR with the commodity of a center added once its district is not connected, @return for optimize and delete
+LazyFlow* build_lshir(GRBModel* model, hess_params& p, graph* g);
+// a-b separator cuts sum_{c in C} x_cb >= x_ab kept across models, keyed by (b, a, C); a cut found
+// again only counts a hit, the hits decide how eagerly the cut is used when injected
+class cut_pool
+{
+private:
+  struct entry { int a, b; std::vector<int> C; int hits; };
+  std::vector<entry> cuts;
+  std::unordered_multimap<unsigned long long, std::size_t> index; // hash -> cuts
+public:
+  // sorts C, @return false if the cut was pooled already
+  bool add(int a, int b, std::vector<int>& C);
+  std::size_t size() const { return cuts.size(); }
+  // adds the pooled cuts not implied by the fixings of [p] as lazy constraints (Lazy 1 to 3
+  // by hits), @return number added
+  int inject(GRBModel* model, const hess_params& p) const;
+};
 // add CUT constraints to model with hess variables x (lazy)
 class HessCallback : public GRBCallback
 {
 protected:
   hess_params& p;
-  double** x_val; // x values
+  std::vector<int> assign; // center of each node in the current solution, -1 if none
   graph* g; // graph pointer
   int n; // g->nr_nodes
   const vector<int> population;
+  bool has_ones; // some x fixed to 1
 public:
-  int numCallbacks; // number of callback calls
+  int numCallbacks; // number of callback calls at MIPSOL
+  int numNodeCallbacks; // fractional separations at MIPNODE
   double callbackTime; // cumulative time in callbacks
   int numLazyCuts;
-  HessCallback(hess_params& p_, graph* g_, const vector<int>& population_) : p(p_), g(g_), population(population_), numCallbacks(0), callbackTime(0.), numLazyCuts(0)
+  int numUserCuts; // fractional cuts at MIPNODE
+  HessCallback(hess_params& p_, graph* g_, const vector<int>& population_) : p(p_), g(g_), population(population_), numCallbacks(0), numNodeCallbacks(0), callbackTime(0.), numLazyCuts(0), numUserCuts(0)
 
   {
     n = g->nr_nodes;
-    x_val = new double*[n];
-    for (int i = 0; i < n; ++i)
-      x_val[i] = new double[n];
+    assign.resize(n);
+    has_ones = p.F->count_one() > 0;
   }
   virtual ~HessCallback()
   {
-    for (int i = 0; i < n; ++i)
-      delete[] x_val[i];
-    delete[] x_val;
   }
 protected:
-  void populate_x()
+  // MIPSOL: one batched getSolution, then the center of every node
+  void populate_assign()
   {
-    for (int i = 0; i < n; ++i)
-      for (int j = 0; j < n; ++j)
-        if (IS_X(i, j))
-          x_val[i][j] = getSolution(X_V(i, j));
-        else if (p.F1[i][j]) x_val[i][j] = 1.; else x_val[i][j] = 0.;
+    int nr_var = static_cast<int>(p.h.size());
+    double* x = getSolution(p.x, nr_var);
+    std::fill(assign.begin(), assign.end(), -1);
+    for (int v = 0; v < nr_var; ++v)
+      if (x[v] > 0.5)
+        assign[p.h.row(v)] = p.h.column(v);
+    delete[] x;
+    if (has_ones)
+      for (int i = 0; i < n; ++i)
+        p.F->for_one(i, [this, i](int j) { assign[i] = j; });
   }
 };
 
 // @return callback for delete only
-HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population);
-HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U);
+// pooled cuts are injected into the model first, new ones are pooled; centers are separated on nr_threads threads
+HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, cut_pool* pool = nullptr, unsigned int nr_threads = 1);
+HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U, cut_pool* pool = nullptr, unsigned int nr_threads = 1);
 //Lagrangian functions
 // input:
 //    g: graph pointer
@@ -77,25 +123,84 @@ HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector
 //    grad : pointer to the resulting gradient
 //    f_val : resulting objective value
 //    currentCenters : the best k centers (for the current multipliers), i.e., the k vertices j that have least W_j
+//    candidates : vertices that may be centers, w_hat and W are only computed for these columns
 void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k, const vector<int>& population,
-  const vector<vector<double>>& w, vector<vector<double>>& w_hat, vector<double>& W, double* grad, double& f_val, vector<bool>& currentCenters);
+  const vector<vector<double>>& w, vector<vector<double>>& w_hat, vector<double>& W, double* grad, double& f_val, vector<bool>& currentCenters,
+  const vector<int>& candidates);
 
+// the best distinct center sets of the Lagrangian inner problems, ranked by the dual value of their point
+class center_pool
+{
+private:
+  size_t capacity;
+  vector<pair<double, vector<int> > > best; // sorted centers, by decreasing value
+public:
+  center_pool(size_t capacity_) : capacity(capacity_) {}
+  void add(const vector<bool>& centers, double value);
+  // best first
+  vector<vector<int> > sets() const;
+  size_t size() const { return best.size(); }
+};
+
+// UB : objective of a known solution, with rp.lagrange_shrink the multipliers of centers j with LB1[j][j] > UB
+//      are dropped from ralg; MYINFINITY keeps all of them
+// seeds : if not null, collects the center sets of the points ralg visits
 double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k,
-  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity);
+  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity,
+  double UB = MYINFINITY, center_pool* seeds = nullptr);
 
 void update_LB(const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1);
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, const vector<int>& candidates);
 
 void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1);
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, const vector<int>& candidates);
+
+// one Gurobi environment and one restricted assignment model (build_hess_restricted) shared by the heuristics.
+// A center is a column position of the model, so moving to other centers only rewrites the objective of the
+// columns that change and which x(j,j) are fixed to 1; the model is rebuilt only after extend()
+class restricted_session
+{
+private:
+  graph* g;
+  const vector<vector<double> >& w;
+  const vector<int>& population;
+  int L, U, k;
+  unique_ptr<GRBEnv> env;
+  unique_ptr<GRBModel> model;
+  hess_params p;
+  vector<int> columns; // center of each column position
+  bool extended;
+public:
+  restricted_session(graph* g_, const vector<vector<double> >& w_, const vector<int>& population_, int L_, int U_, int k_)
+    : g(g_), w(w_), population(population_), L(L_), U(U_), k(k_), extended(false) {}
+  // started on first use
+  GRBEnv& environment();
+  // the restricted model over [centers], each center assigned to itself; params() index its variables
+  GRBModel& restrict_to(const vector<int>& centers);
+  hess_params& params() { return p; }
+  // constraints or fixings were added to the restricted model, the next restrict_to() builds a fresh one
+  void extend() { extended = true; }
+  // frees the restricted model, the environment stays
+  void release_model() { model.reset(); columns.clear(); }
+  // restricted IP for [centers] with [solution] as MIP start; if it finds an assignment better than [obj]
+  // it is copied to [solution] and its objective returned, otherwise obj
+  double polish(const vector<int>& centers, vector<int>& solution, double obj, bool do_cuts);
+};
 
+// maxIterations restarts of Hess descent on nr_threads threads, UB is also the starting cutoff; after restart 0
+// they run in batches of [batch] (0 = nr_threads), the result is the same for any nr_threads at a fixed batch.
+// Restricted IPs use [session], or a session of their own if it is null. Restart r starts from (*seeds)[r] if there is one
 vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, double &UB, int maxIterations, bool do_cuts = false);
+  int L, int U, int k, double &UB, int maxIterations, bool do_cuts = false, unsigned int nr_threads = 1,
+  unsigned int batch = 0, restricted_session* session = nullptr, const vector<vector<int> >* seeds = nullptr);
 
 void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<vector<double> > &w, 
-  const vector<int> &population, int L, int U, int k, double &UB, string arg_model);
+  const vector<int> &population, int L, int U, int k, double &UB, string arg_model, cut_pool* pool = nullptr,
+  restricted_session* session = nullptr);
 
+// best-improvement center swaps from heuristicSolution, swaps evaluated on nr_threads threads
 bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, vector<int>&heuristicSolution, double &UB);
+  int L, int U, int k, vector<int>&heuristicSolution, double &UB, unsigned int nr_threads = 1,
+  restricted_session* session = nullptr);
 
 #endif
@@ -0,0 +1,42 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+// a fixed set of worker threads; the calling thread takes part in every run, so
+// thread_pool(0) runs everything inline
+class thread_pool
+{
+private:
+  std::vector<std::thread> workers;
+  std::mutex m;
+  std::condition_variable cv_start;
+  std::condition_variable cv_done;
+  const std::function<void (unsigned int, unsigned int)>* job; // (index, thread id)
+  unsigned int count;
+  std::atomic<unsigned int> next;
+  unsigned int generation;
+  unsigned int busy;
+  bool stop;
+  void work(unsigned int tid);
+  void drain(unsigned int tid);
+public:
+  thread_pool(unsigned int nr_workers);
+  ~thread_pool();
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+  // number of threads taking part in run(), thread ids are in [0, size())
+  unsigned int size() const { return static_cast<unsigned int>(workers.size()) + 1; }
+  // call f(i, tid) for every i in [0, count), returns when all calls are done
+  void run(unsigned int count, const std::function<void (unsigned int, unsigned int)>& f);
+};
+
+// number of threads to use if the user asked for [requested], 0 means all cores
+unsigned int resolve_threads(int requested);
+
+#endif
@@ -2,14 +2,51 @@
 #define RALG_H
 
 #include <cfloat>
+#include <cstdio>
+#include <cstdint>
 #include <functional> // C++11 std::function
 #include <climits>
+#include <vector>
 
 #define RALG_MAX false
 #define RALG_MIN true
 
 #define RALG_UNLIMITED_ITER UINT_MAX
 
+// one iteration of ralg, 64 bytes without padding (binary trace format)
+struct ralg_trace_record
+{
+    uint32_t iter;
+    uint32_t nr_evals; // line search evaluations
+    uint32_t nr_matrix_reset; // so far
+    uint32_t reserved;
+    double f_val;
+    double step;
+    double norm;
+    double diff;
+    double t_callback; // seconds in cb_eval/cb_accept
+    double t_blas; // seconds in the rest but printing, mostly BLAS
+};
+
+// buffer of trace records, flushed to [fname] when full and on destruction
+// CSV if fname ends with .csv, otherwise binary: "RALGTRC1", then raw records
+class ralg_trace
+{
+private:
+    std::vector<ralg_trace_record> buf;
+    size_t used;
+    FILE* f;
+    bool csv;
+public:
+    ralg_trace(const char* fname, size_t capacity = 4096);
+    ~ralg_trace();
+    ralg_trace(const ralg_trace&) = delete;
+    ralg_trace& operator=(const ralg_trace&) = delete;
+    bool ok() const { return f != nullptr; }
+    void push(const ralg_trace_record& r) { buf[used++] = r; if(used == buf.size()) flush(); }
+    void flush();
+};
+
 struct ralg_options
 {
     double q1; // 0.95
@@ -27,6 +64,8 @@ struct ralg_options
     unsigned int output_iter;
     double b_init;
     bool is_monotone;
+    unsigned int ls_parallel; // 1
+    ralg_trace* trace; // nullptr
 };
 
 const ralg_options defaultOptions = {
@@ -59,7 +98,26 @@ const ralg_options defaultOptions = {
   // b_init
   1.,
   // is_monotone
-  true
+  true,
+  // ls_parallel
+  1, // sequential line search
+  // trace
+  nullptr
+};
+
+// view of the r-algorithm state between two iterations, arrays have DIMENSION entries, B is DIMENSION^2 row-major
+struct ralg_state
+{
+  unsigned int iter;
+  unsigned int nr_matrix_reset;
+  double step;
+  double f_val;
+  double f_optimal;
+  double* xk;
+  double* grad; // gradient at xk
+  double* res; // best point so far if not monotone
+  double* B;
+  bool evaluated; // f_val and grad belong to xk
 };
 
 double ralg(const ralg_options* opt,
@@ -68,5 +126,21 @@ double ralg(const ralg_options* opt,
           double* x0,
           double* res, bool min=RALG_MIN);
 
+// speculative line search: up to opt->ls_parallel trial steps are evaluated at once
+// cb_eval(x, f_val, grad, ws) works on workspace ws < opt->ls_parallel, calls with distinct ws run concurrently
+// cb_accept(ws) is called serially, in order, for every point the sequential line search would have visited,
+// so the iterates and side effects match ls_parallel = 1
+// cb_iter (optional) sees the state after every iteration that is followed by another one, return false to stop
+// cb_resume (optional) fills the state instead of starting from x0, return false to start from x0 anyway;
+// a state that is not evaluated is evaluated at xk first
+double ralg(const ralg_options* opt,
+          std::function<bool (const double*, double&, double*, unsigned int)> cb_eval,
+          std::function<void (unsigned int)> cb_accept,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res, bool min=RALG_MIN,
+          std::function<bool (const ralg_state&)> cb_iter=nullptr,
+          std::function<bool (ralg_state&)> cb_resume=nullptr);
+
 #endif // RALG_H
 
@@ -0,0 +1,432 @@
+// source file for the native capacitated assignment solver
+#include <vector>
+#include <algorithm>
+
+#include "districting/assign.hpp"
+#include "districting/common.hpp"
+
+using namespace std;
+
+// subgradient rounds of the Lagrangian fallback
+const int AssignLagrangeIterations = 30;
+// passes of improving moves after a repair
+const int AssignImprovePasses = 50;
+// cheapest nodes per district pair tried in swaps when no single move helps
+const int AssignSwapCandidates = 30;
+
+assignment_solver::assignment_solver(const vector<vector<double>>& w_, const vector<int>& population_, int L_, int U_)
+  : w(w_), population(population_), L(L_), U(U_), lp_bound(0.)
+{
+  n = static_cast<int>(population.size());
+  center_of.assign(n, -1);
+}
+
+void assignment_solver::update_moves(int c, int k)
+{
+  fill(move.begin() + c * k, move.begin() + (c + 1) * k, MYINFINITY);
+  vector<int>& mem = members[c];
+  size_t kept = 0;
+  for (int t : mem)
+  {
+    if (flow[t * k + c] == 0)
+      continue;
+    mem[kept++] = t;
+    for (int d = 0; d < k; ++d)
+      if (d != c && unit[t * k + d] - unit[t * k + c] < move[c * k + d])
+      {
+        move[c * k + d] = unit[t * k + d] - unit[t * k + c];
+        via[c * k + d] = t;
+      }
+  }
+  mem.resize(kept);
+}
+
+bool assignment_solver::solve_lp(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  supply.clear();
+  for (int i = 0; i < n; ++i)
+    if (center_of[i] < 0 && population[i] > 0)
+      supply.push_back(i);
+  int m = supply.size();
+  unit.resize(static_cast<size_t>(m) * k);
+  flow.assign(static_cast<size_t>(m) * k, 0);
+  double max_cost = 0.;
+  for (int t = 0; t < m; ++t)
+    for (int c = 0; c < k; ++c)
+    {
+      unit[t * k + c] = w[supply[t]][centers[c]] / population[supply[t]];
+      max_cost = max(max_cost, myabs(unit[t * k + c]));
+    }
+  // the first L units into a center earn -big, more than any path can gain by moving flow between
+  // centers, so the lower bounds are met whenever possible
+  double big = 4. * (k + 1) * (max_cost + 1.);
+  lower.resize(k);
+  upper.resize(k);
+  for (int c = 0; c < k; ++c)
+  {
+    lower[c] = max(0LL, static_cast<long long>(L) - load[c]);
+    upper[c] = U - load[c] - lower[c];
+  }
+  members.assign(k, vector<int>());
+  move.assign(static_cast<size_t>(k) * k, MYINFINITY);
+  via.assign(static_cast<size_t>(k) * k, -1);
+  pi.assign(k, 0.); // no flow yet, so no moves
+  dist.resize(k);
+  pred.resize(k);
+  done.resize(k);
+
+  for (int t = 0; t < m; ++t)
+  {
+    long long rem = population[supply[t]];
+    while (rem > 0)
+    {
+      // Dijkstra on the centers, reduced costs move + pi[c] - pi[c'] are nonnegative
+      for (int c = 0; c < k; ++c)
+      {
+        dist[c] = unit[t * k + c];
+        pred[c] = -1;
+        done[c] = 0;
+      }
+      for (int r = 0; r < k; ++r)
+      {
+        int c = -1;
+        for (int d = 0; d < k; ++d)
+          if (!done[d] && (c < 0 || dist[d] - pi[d] < dist[c] - pi[c]))
+            c = d;
+        done[c] = 1;
+        for (int d = 0; d < k; ++d)
+          if (!done[d] && move[c * k + d] < MYINFINITY && dist[c] + move[c * k + d] < dist[d])
+          {
+            dist[d] = dist[c] + move[c * k + d];
+            pred[d] = c;
+          }
+      }
+      int last = -1;
+      double best = MYINFINITY;
+      for (int c = 0; c < k; ++c)
+      {
+        double to_sink = lower[c] > 0 ? -big : (upper[c] > 0 ? 0. : MYINFINITY);
+        if (to_sink < MYINFINITY && dist[c] + to_sink < best)
+        {
+          best = dist[c] + to_sink;
+          last = c;
+        }
+      }
+      if (last < 0)
+        return false; // more population than the upper bounds allow
+      long long amount = min(rem, lower[last] > 0 ? lower[last] : upper[last]);
+      for (int c = last; pred[c] >= 0; c = pred[c])
+        amount = min(amount, flow[via[pred[c] * k + c] * k + pred[c]]);
+      (lower[last] > 0 ? lower[last] : upper[last]) -= amount;
+      int c = last;
+      for (; pred[c] >= 0; c = pred[c])
+      {
+        int f = via[pred[c] * k + c];
+        flow[f * k + pred[c]] -= amount;
+        if (flow[f * k + c] == 0)
+          members[c].push_back(f);
+        flow[f * k + c] += amount;
+      }
+      if (flow[t * k + c] == 0)
+        members[c].push_back(t);
+      flow[t * k + c] += amount;
+      rem -= amount;
+      for (int d = last; ; d = pred[d])
+      {
+        update_moves(d, k);
+        if (pred[d] < 0)
+          break;
+      }
+      for (int d = 0; d < k; ++d)
+        pi[d] = dist[d];
+    }
+  }
+  for (int c = 0; c < k; ++c)
+    if (lower[c] > 0)
+      return false; // not enough population for the lower bounds
+
+  lp_bound = 0.;
+  for (int c = 0; c < k; ++c)
+    lp_bound += w[centers[c]][centers[c]];
+  for (int t = 0; t < m; ++t)
+  {
+    int best = 0;
+    for (int c = 0; c < k; ++c)
+    {
+      lp_bound += flow[t * k + c] * unit[t * k + c];
+      if (flow[t * k + c] > flow[t * k + best])
+        best = c;
+    }
+    assignment[supply[t]] = centers[best];
+  }
+  // population 0 nodes do not count for the bounds
+  for (int i = 0; i < n; ++i)
+    if (center_of[i] < 0 && population[i] == 0)
+    {
+      int best = centers[0];
+      for (int j : centers)
+        if (w[i][j] < w[i][best])
+          best = j;
+      assignment[i] = best;
+      lp_bound += w[i][best];
+    }
+  return true;
+}
+
+bool assignment_solver::repair(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  fill(load.begin(), load.end(), 0);
+  for (int i = 0; i < n; ++i)
+    load[center_of[assignment[i]]] += population[i];
+  long long total_violation = 0;
+  for (int c = 0; c < k; ++c)
+    total_violation += violation(c);
+
+  // cheapest move per unit of violation removed, until none is left
+  for (int step = 0; step < n && total_violation > 0; ++step)
+  {
+    int best_i = -1, best_c = -1;
+    long long best_gain = 0;
+    double best_score = MYINFINITY;
+    for (int i = 0; i < n; ++i)
+    {
+      if (center_of[i] >= 0 || population[i] == 0)
+        continue;
+      int from = center_of[assignment[i]];
+      long long before_from = violation(from);
+      load[from] -= population[i];
+      long long after_from = violation(from);
+      for (int c = 0; c < k; ++c)
+      {
+        if (c == from)
+          continue;
+        long long before_to = violation(c);
+        load[c] += population[i];
+        long long gain = before_from + before_to - after_from - violation(c);
+        load[c] -= population[i];
+        if (gain <= 0)
+          continue;
+        double score = (w[i][centers[c]] - w[i][assignment[i]]) / gain;
+        if (score < best_score)
+        {
+          best_score = score;
+          best_gain = gain;
+          best_i = i;
+          best_c = c;
+        }
+      }
+      load[from] += population[i];
+    }
+    if (best_i < 0)
+    {
+      // single moves overshoot when [L, U] is narrow, exchange two nodes instead
+      long long gain = swap(centers, assignment);
+      if (gain <= 0)
+        return false;
+      total_violation -= gain;
+      continue;
+    }
+    load[center_of[assignment[best_i]]] -= population[best_i];
+    load[best_c] += population[best_i];
+    assignment[best_i] = centers[best_c];
+    total_violation -= best_gain;
+  }
+  return total_violation == 0;
+}
+
+long long assignment_solver::swap(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  by_center.assign(k, vector<int>());
+  for (int i = 0; i < n; ++i)
+    if (center_of[i] < 0 && population[i] > 0)
+      by_center[center_of[assignment[i]]].push_back(i);
+
+  // the cheapest nodes of district c to leave for d
+  vector<pair<double, int>> out_c, out_d;
+  auto cheapest = [&](int c, int d, vector<pair<double, int>>& out) {
+    out.clear();
+    for (int i : by_center[c])
+      out.push_back(make_pair(w[i][centers[d]] - w[i][centers[c]], i));
+    size_t T = min(out.size(), static_cast<size_t>(AssignSwapCandidates));
+    partial_sort(out.begin(), out.begin() + T, out.end());
+    out.resize(T);
+  };
+
+  int best_a = -1, best_b = -1;
+  long long best_gain = 0;
+  double best_score = MYINFINITY;
+  for (int c = 0; c < k; ++c)
+    for (int d = c + 1; d < k; ++d)
+    {
+      if (violation(c) == 0 && violation(d) == 0)
+        continue;
+      cheapest(c, d, out_c);
+      cheapest(d, c, out_d);
+      long long before = violation(c) + violation(d);
+      for (auto& a : out_c)
+        for (auto& b : out_d)
+        {
+          long long shift = population[a.second] - population[b.second]; // from c to d
+          load[c] -= shift; load[d] += shift;
+          long long gain = before - violation(c) - violation(d);
+          load[c] += shift; load[d] -= shift;
+          if (gain <= 0)
+            continue;
+          double score = (a.first + b.first) / gain;
+          if (score < best_score)
+          {
+            best_score = score;
+            best_gain = gain;
+            best_a = a.second;
+            best_b = b.second;
+          }
+        }
+    }
+  if (best_a < 0)
+    return 0;
+  int c = center_of[assignment[best_a]], d = center_of[assignment[best_b]];
+  long long shift = population[best_a] - population[best_b];
+  load[c] -= shift;
+  load[d] += shift;
+  assignment[best_a] = centers[d];
+  assignment[best_b] = centers[c];
+  return best_gain;
+}
+
+void assignment_solver::improve(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  bool improved = true;
+  for (int pass = 0; pass < AssignImprovePasses && improved; ++pass)
+  {
+    improved = false;
+    for (int i = 0; i < n; ++i)
+    {
+      if (center_of[i] >= 0)
+        continue;
+      int from = center_of[assignment[i]];
+      if (load[from] - population[i] < L)
+        continue;
+      int best = from;
+      for (int c = 0; c < k; ++c)
+        if (c != from && load[c] + population[i] <= U && w[i][centers[c]] < w[i][centers[best]])
+          best = c;
+      if (best != from)
+      {
+        load[from] -= population[i];
+        load[best] += population[i];
+        assignment[i] = centers[best];
+        improved = true;
+      }
+    }
+  }
+}
+
+bool assignment_solver::lagrangian_repair(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  price.assign(k, 0.);
+  vector<int> trial(n);
+  double best_obj = MYINFINITY;
+
+  // initial step: the spread of costs per unit of population
+  double spread = 0.;
+  long long total = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    if (center_of[i] >= 0 || population[i] == 0)
+      continue;
+    double lo = MYINFINITY, hi = -MYINFINITY;
+    for (int j : centers)
+    {
+      lo = min(lo, w[i][j]);
+      hi = max(hi, w[i][j]);
+    }
+    spread += hi - lo;
+    total += population[i];
+  }
+  double step = total > 0 ? spread / total : 1.;
+
+  for (int iter = 0; iter < AssignLagrangeIterations; ++iter)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      if (center_of[i] >= 0)
+      {
+        trial[i] = i;
+        continue;
+      }
+      int best = 0;
+      for (int c = 1; c < k; ++c)
+        if (w[i][centers[c]] + population[i] * price[c] < w[i][centers[best]] + population[i] * price[best])
+          best = c;
+      trial[i] = centers[best];
+    }
+    fill(load.begin(), load.end(), 0);
+    for (int i = 0; i < n; ++i)
+      load[center_of[trial[i]]] += population[i];
+    // subgradient of the relaxed bounds, then the prices for the next round
+    vector<long long> excess(k);
+    for (int c = 0; c < k; ++c)
+      excess[c] = load[c] > U ? load[c] - U : (load[c] < L ? load[c] - L : 0);
+    if (repair(centers, trial))
+    {
+      improve(centers, trial);
+      double obj = 0.;
+      for (int i = 0; i < n; ++i)
+        obj += w[i][trial[i]];
+      if (obj < best_obj)
+      {
+        best_obj = obj;
+        assignment = trial;
+      }
+    }
+    for (int c = 0; c < k; ++c)
+      price[c] += step * excess[c] / max(1LL, static_cast<long long>(U - L));
+    step *= 0.9;
+  }
+  return best_obj < MYINFINITY;
+}
+
+double assignment_solver::solve(const vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  assignment.assign(n, -1);
+  load.assign(k, 0);
+  bool ok = k > 0;
+  for (int c = 0; c < k; ++c)
+  {
+    center_of[centers[c]] = c;
+    assignment[centers[c]] = centers[c];
+    load[c] = population[centers[c]];
+    if (load[c] > U)
+      ok = false;
+  }
+
+  double obj = MYINFINITY;
+  if (ok && solve_lp(centers, assignment))
+  {
+    if (repair(centers, assignment))
+      improve(centers, assignment);
+    else if (!lagrangian_repair(centers, assignment))
+      ok = false;
+    if (ok)
+    {
+      // loads follow the last trial in the fallback, recompute for the final improvement
+      fill(load.begin(), load.end(), 0);
+      for (int i = 0; i < n; ++i)
+        load[center_of[assignment[i]]] += population[i];
+      improve(centers, assignment);
+      obj = 0.;
+      for (int i = 0; i < n; ++i)
+        obj += w[i][assignment[i]];
+    }
+  }
+
+  for (int j : centers)
+    center_of[j] = -1;
+  return obj;
+}
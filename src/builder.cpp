@@ -0,0 +1,69 @@
+// source file for batched model construction
+#include <vector>
+
+#include "gurobi_c++.h"
+
+#include "districting/builder.hpp"
+
+using namespace std;
+
+// rows per addConstrs call, bounds the memory of the temporary GRBLinExpr array
+const size_t BuilderChunkRows = 1 << 16;
+
+void row_builder::end(char sense_, double rhs_)
+{
+  start.push_back(var.size());
+  sense.push_back(sense_);
+  rhs.push_back(rhs_ - constant);
+  constant = 0.;
+  if (sense.size() >= BuilderChunkRows)
+    flush();
+}
+
+void row_builder::flush()
+{
+  size_t nr_rows = sense.size();
+  if (nr_rows == 0)
+    return;
+  GRBLinExpr* rows = new GRBLinExpr[nr_rows];
+  for (size_t r = 0; r < nr_rows; ++r)
+    rows[r].addTerms(coef.data() + start[r], var.data() + start[r], static_cast<int>(start[r + 1] - start[r]));
+  GRBConstr* constrs = model->addConstrs(rows, sense.data(), rhs.data(), nullptr, static_cast<int>(nr_rows));
+  delete[] constrs;
+  delete[] rows;
+
+  start.assign(1, 0);
+  var.clear();
+  coef.clear();
+  sense.clear();
+  rhs.clear();
+}
+
+void set_column_obj(GRBModel* model, const hess_params& p, int j, const vector<vector<double>>& w, int c)
+{
+  vector<GRBVar> vars;
+  vector<double> vals;
+  vars.reserve(p.n);
+  vals.reserve(p.n);
+  for (int i = 0; i < p.n; ++i)
+    if (p.h.has(i, j))
+    {
+      vars.push_back(p.x[p.h(i, j)]);
+      vals.push_back(w[i][c]);
+    }
+  model->set(GRB_DoubleAttr_Obj, vars.data(), vals.data(), static_cast<int>(vars.size()));
+}
+
+void set_hess_obj(GRBModel* model, const hess_params& p, const vector<vector<double>>& w)
+{
+  int nr_var = static_cast<int>(p.h.size());
+  vector<double> vals(nr_var, 0.);
+  double constant = 0.;
+  for (int i = 0; i < p.n; ++i)
+  {
+    p.F->for_free(i, [&](int j) { vals[p.h(i, j)] = w[i][j]; });
+    p.F->for_one(i, [&](int j) { constant += w[i][j]; });
+  }
+  model->set(GRB_DoubleAttr_Obj, p.x, vals.data(), nr_var);
+  model->set(GRB_DoubleAttr_ObjCon, constant);
+}
@@ -0,0 +1,133 @@
+// source file for the Lagrangian checkpoint, kept apart from io.cpp as it needs no Gurobi
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#ifndef _WIN32
+#include <unistd.h> // fsync
+#endif
+
+#include "districting/io.hpp"
+#include "districting/ralg.hpp"
+
+using namespace std;
+
+static const char checkpoint_magic[8] = {'R','A','L','G','C','K','P','2'};
+
+bool dump_lagrange_checkpoint(const char* fname, const ralg_state& st, const vector<int>& active, const vector<double>& base,
+  double LB, const vector<vector<double>>& LB1)
+{
+  string tmpname = string(fname) + ".tmp";
+  FILE* f = fopen(tmpname.c_str(), "wb");
+  if(!f)
+  {
+    fprintf(stderr, "Cannot open %s for checkpoint.\n", tmpname.c_str());
+    return false;
+  }
+  unsigned int dim = active.size();
+  unsigned int n = LB1.size();
+  size_t full_dim = base.size();
+  bool ok = fwrite(checkpoint_magic, sizeof(checkpoint_magic), 1, f) == 1;
+  ok = ok && fwrite(&dim, sizeof(dim), 1, f) == 1 && fwrite(&n, sizeof(n), 1, f) == 1;
+  ok = ok && fwrite(active.data(), sizeof(int), dim, f) == dim;
+  ok = ok && fwrite(&st.iter, sizeof(st.iter), 1, f) == 1 && fwrite(&st.nr_matrix_reset, sizeof(st.nr_matrix_reset), 1, f) == 1;
+  ok = ok && fwrite(&st.step, sizeof(double), 1, f) == 1 && fwrite(&st.f_val, sizeof(double), 1, f) == 1;
+  ok = ok && fwrite(&st.f_optimal, sizeof(double), 1, f) == 1 && fwrite(&LB, sizeof(double), 1, f) == 1;
+  ok = ok && fwrite(base.data(), sizeof(double), full_dim, f) == full_dim;
+  ok = ok && fwrite(st.xk, sizeof(double), dim, f) == dim;
+  ok = ok && fwrite(st.grad, sizeof(double), dim, f) == dim;
+  ok = ok && fwrite(st.res, sizeof(double), dim, f) == dim;
+  for(unsigned int i = 0; ok && i < dim; ++i)
+    ok = fwrite(st.B + static_cast<size_t>(i)*dim, sizeof(double), dim, f) == dim;
+  for(unsigned int i = 0; ok && i < n; ++i)
+    ok = fwrite(LB1[i].data(), sizeof(double), n, f) == n;
+  ok = ok && fflush(f) == 0;
+#ifndef _WIN32
+  ok = ok && fsync(fileno(f)) == 0;
+#endif
+  ok = (fclose(f) == 0) && ok;
+  // the old checkpoint is replaced only by a complete one
+  if(!ok || rename(tmpname.c_str(), fname) != 0)
+  {
+    fprintf(stderr, "Failed to write checkpoint %s.\n", fname);
+    remove(tmpname.c_str());
+    return false;
+  }
+  return true;
+}
+
+// read the header up to the active coordinates, leaves f after them
+static FILE* open_lagrange_checkpoint(const char* fname, unsigned int n, vector<int>& active)
+{
+  FILE* f = fopen(fname, "rb");
+  if(!f)
+  {
+    fprintf(stderr, "WARNING: Failed to open checkpoint %s!\n", fname);
+    return nullptr;
+  }
+  char magic[sizeof(checkpoint_magic)];
+  unsigned int f_dim = 0, f_n = 0;
+  bool ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, checkpoint_magic, sizeof(magic)) == 0;
+  ok = ok && fread(&f_dim, sizeof(f_dim), 1, f) == 1 && fread(&f_n, sizeof(f_n), 1, f) == 1;
+  if(ok && (f_n != n || f_dim > 3*n))
+  {
+    fprintf(stderr, "Checkpoint %s is for n = %u, expected %u.\n", fname, f_n, n);
+    fclose(f);
+    return nullptr;
+  }
+  if(ok)
+  {
+    active.resize(f_dim);
+    ok = fread(active.data(), sizeof(int), f_dim, f) == f_dim;
+  }
+  if(!ok)
+  {
+    fprintf(stderr, "Checkpoint %s is corrupted.\n", fname);
+    fclose(f);
+    return nullptr;
+  }
+  return f;
+}
+
+bool peek_lagrange_checkpoint(const char* fname, unsigned int n, vector<int>& active)
+{
+  FILE* f = open_lagrange_checkpoint(fname, n, active);
+  if(!f)
+    return false;
+  fclose(f);
+  return true;
+}
+
+bool read_lagrange_checkpoint(const char* fname, ralg_state& st, const vector<int>& active, vector<double>& base,
+  double& LB, vector<vector<double>>& LB1)
+{
+  unsigned int n = LB1.size();
+  vector<int> f_active;
+  FILE* f = open_lagrange_checkpoint(fname, n, f_active);
+  if(!f)
+    return false;
+  if(f_active != active)
+  {
+    fprintf(stderr, "Checkpoint %s changed while reading.\n", fname);
+    fclose(f);
+    return false;
+  }
+  unsigned int dim = active.size();
+  size_t full_dim = base.size();
+  bool ok = fread(&st.iter, sizeof(st.iter), 1, f) == 1 && fread(&st.nr_matrix_reset, sizeof(st.nr_matrix_reset), 1, f) == 1;
+  ok = ok && fread(&st.step, sizeof(double), 1, f) == 1 && fread(&st.f_val, sizeof(double), 1, f) == 1;
+  ok = ok && fread(&st.f_optimal, sizeof(double), 1, f) == 1 && fread(&LB, sizeof(double), 1, f) == 1;
+  ok = ok && fread(base.data(), sizeof(double), full_dim, f) == full_dim;
+  ok = ok && fread(st.xk, sizeof(double), dim, f) == dim;
+  ok = ok && fread(st.grad, sizeof(double), dim, f) == dim;
+  ok = ok && fread(st.res, sizeof(double), dim, f) == dim;
+  for(unsigned int i = 0; ok && i < dim; ++i)
+    ok = fread(st.B + static_cast<size_t>(i)*dim, sizeof(double), dim, f) == dim;
+  for(unsigned int i = 0; ok && i < n; ++i)
+    ok = fread(LB1[i].data(), sizeof(double), n, f) == n;
+  fclose(f);
+  if(!ok)
+    fprintf(stderr, "Checkpoint %s is corrupted.\n", fname);
+  st.evaluated = ok;
+  return ok;
+}
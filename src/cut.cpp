@@ -1,178 +1,632 @@
 // source file for cut based formulations
 #include <chrono>
-#include <unordered_set>
+#include <vector>
+#include <algorithm>
 #include <queue> // priority queue
+#include <unordered_map>
+#include <mutex>
 
 #include "gurobi_c++.h"
 
 #include "districting/graph.hpp"
 #include "districting/models.hpp"
+#include "districting/parallel.hpp"
 
 const bool do_reverse_nb = true; // controls whether cut C is found near a (true) or near b (false)
+const size_t LcutMemoMax = 1 << 16; // refined lcut separators kept across callbacks
+// pooled cuts found this often are injected with Lazy=2 (pulled in by the LP) and Lazy=3 (at the root)
+const int PoolLazy2Hits = 2;
+const int PoolLazy3Hits = 4;
+
+// hash of the cut (b, a, C), C sorted
+static unsigned long long separator_hash(int a, int b, const std::vector<int>& C)
+{
+  unsigned long long key = ((static_cast<unsigned long long>(b) << 32) | static_cast<unsigned int>(a)) * 1099511628211ULL;
+  for (int c : C)
+    key = (key ^ static_cast<unsigned long long>(c)) * 1099511628211ULL;
+  return key;
+}
+
+bool cut_pool::add(int a, int b, std::vector<int>& C)
+{
+  std::sort(C.begin(), C.end());
+  unsigned long long key = separator_hash(a, b, C);
+  auto range = index.equal_range(key);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    entry& e = cuts[it->second];
+    if (e.a == a && e.b == b && e.C == C)
+    {
+      ++e.hits;
+      return false;
+    }
+  }
+  index.emplace(key, cuts.size());
+  cuts.push_back(entry{a, b, C, 1});
+  return true;
+}
+
+int cut_pool::inject(GRBModel* model, const hess_params& p) const
+{
+  std::vector<GRBLinExpr> rows;
+  std::vector<int> lazy;
+  for (const entry& e : cuts)
+  {
+    if (p.F->is_zero(e.a, e.b))
+      continue; // x_ab = 0
+    bool implied = false;
+    GRBLinExpr expr = 0;
+    for (int c : e.C)
+      if (p.F->is_one(c, e.b))
+        implied = true; // some x_cb = 1
+      else if (!p.F->is_zero(c, e.b))
+        expr += X_V(c, e.b);
+    if (implied)
+      continue;
+    expr -= X(e.a, e.b);
+    rows.push_back(expr);
+    lazy.push_back(e.hits >= PoolLazy3Hits ? 3 : (e.hits >= PoolLazy2Hits ? 2 : 1));
+  }
+  if (rows.empty())
+    return 0;
+  int cnt = static_cast<int>(rows.size());
+  std::vector<char> sense(cnt, GRB_GREATER_EQUAL);
+  std::vector<double> rhs(cnt, 0.);
+  GRBConstr* constrs = model->addConstrs(rows.data(), sense.data(), rhs.data(), nullptr, cnt);
+  model->set(GRB_IntAttr_Lazy, constrs, lazy.data(), cnt);
+  delete[] constrs;
+  return cnt;
+}
+
+// user cuts at MIPNODE: budget per node, violation needed and the least x_ab worth a max-flow
+const int UserCutsPerNode = 100;
+const double UserCutTimePerNode = 0.05; // seconds
+const double UserCutViolation = 0.01;
+const double UserCutMinX = 0.1;
+
+// minimum weight a-b vertex separators, Dinic on the split graph (v_in -> v_out with capacity w_v)
+// of the vertices H with positive weight; vertices outside H weigh 0 and end up in the separator
+class vertex_separator
+{
+private:
+  graph* g;
+  std::vector<int> loc; // vertex -> position in H, -1 outside H
+  std::vector<int> verts; // H
+  std::vector<int> first_arc; // per split node, adjacency as linked lists
+  std::vector<int> next_arc;
+  std::vector<int> to;
+  std::vector<double> cap;
+  std::vector<double> cap0; // capacities before the flow
+  std::vector<int> level;
+  std::vector<int> it;
+  std::vector<int> q;
+  std::vector<int> path; // arcs of the augmenting path from s
+  void add_arc(int u, int v, double c)
+  {
+    to.push_back(v); cap0.push_back(c); next_arc.push_back(first_arc[u]); first_arc[u] = to.size() - 1;
+    to.push_back(u); cap0.push_back(0.); next_arc.push_back(first_arc[v]); first_arc[v] = to.size() - 1;
+  }
+  bool bfs(int s, int t)
+  {
+    std::fill(level.begin(), level.end(), -1);
+    q.clear(); q.push_back(s); level[s] = 0;
+    for (size_t h = 0; h < q.size(); ++h)
+      for (int e = first_arc[q[h]]; e != -1; e = next_arc[e])
+        if (cap[e] > 1e-9 && level[to[e]] < 0)
+        {
+          level[to[e]] = level[q[h]] + 1;
+          q.push_back(to[e]);
+        }
+    return level[t] >= 0;
+  }
+  // one s-t path in the level graph, pushed with its bottleneck; it[u] is the next arc to try from u,
+  // dead ends are left by their level. Iterative, paths run through up to 2|H| split nodes
+  double augment(int s, int t)
+  {
+    path.clear();
+    int u = s;
+    while (u != t)
+    {
+      int& e = it[u];
+      while (e != -1 && !(cap[e] > 1e-9 && level[to[e]] == level[u] + 1))
+        e = next_arc[e];
+      if (e != -1)
+      {
+        path.push_back(e);
+        u = to[e];
+        continue;
+      }
+      if (path.empty())
+        return 0.;
+      level[u] = -1;
+      u = to[path.back() ^ 1];
+      path.pop_back();
+      it[u] = next_arc[it[u]];
+    }
+    double f = MYINFINITY;
+    for (int e : path)
+      f = std::min(f, cap[e]);
+    for (int e : path)
+    {
+      cap[e] -= f;
+      cap[e ^ 1] += f;
+    }
+    return f;
+  }
+public:
+  vertex_separator(graph* g_) : g(g_), loc(g_->nr_nodes, -1) {}
+  // the network of weights w[t] for the vertices H[t]
+  void build(const std::vector<int>& H, const std::vector<double>& w)
+  {
+    for (int v : verts)
+      loc[v] = -1;
+    verts = H;
+    for (size_t t = 0; t < verts.size(); ++t)
+      loc[verts[t]] = t;
+    int nr_split = 2 * verts.size();
+    first_arc.assign(nr_split, -1);
+    next_arc.clear(); to.clear(); cap0.clear();
+    for (size_t t = 0; t < verts.size(); ++t)
+    {
+      add_arc(2 * t, 2 * t + 1, w[t]);
+      for (int nb : g->nb(verts[t]))
+        if (loc[nb] >= 0)
+          add_arc(2 * t + 1, 2 * loc[nb], MYINFINITY);
+    }
+    level.resize(nr_split);
+    it.resize(nr_split);
+  }
+  // max flow from a to b (both in H, their own weights ignored), stops once it reaches bound
+  double max_flow(int a, int b, double bound)
+  {
+    cap = cap0;
+    // a and b are not part of any separator
+    for (int v : {a, b})
+      for (int e = first_arc[2 * loc[v]]; e != -1; e = next_arc[e])
+        if (to[e] == 2 * loc[v] + 1)
+          cap[e] = MYINFINITY;
+    int s = 2 * loc[a] + 1, t = 2 * loc[b];
+    double flow = 0.;
+    while (flow < bound && bfs(s, t))
+    {
+      for (size_t u = 0; u < it.size(); ++u)
+        it[u] = first_arc[u];
+      double f;
+      while (flow < bound && (f = augment(s, t)) > 0)
+        flow += f;
+    }
+    return flow;
+  }
+  // after max_flow: the vertices next to the out-nodes reachable from a, i.e. a minimum separator
+  void separator(int a, std::vector<int>& C, std::vector<unsigned int>& mark, unsigned int epoch)
+  {
+    bfs(2 * loc[a] + 1, 2 * loc[a] + 1);
+    C.clear();
+    for (size_t t = 0; t < verts.size(); ++t)
+      if (level[2 * t + 1] >= 0)
+        mark[verts[t]] = epoch;
+    for (size_t t = 0; t < verts.size(); ++t)
+      if (level[2 * t + 1] >= 0)
+        for (int nb : g->nb(verts[t]))
+          if (mark[nb] != epoch)
+          {
+            mark[nb] = epoch;
+            C.push_back(nb);
+          }
+  }
+};
+
+// scratch of one thread separating centers; marks are valid when equal to the current epoch,
+// so nothing is cleared per center or component
+struct cut_scratch
+{
+  std::vector<unsigned int> in_cc; // district dfs marks, C_b and the components seen
+  std::vector<unsigned int> visited; // separator dfs marks
+  std::vector<unsigned int> aci; // A(C_b) set
+  std::vector<unsigned int> in_c; // separator C
+  unsigned int epoch;
+  std::vector<int> s; // stack for DFS
+  std::vector<int> C; // separator
+  std::vector<int> dist; // population distance from a in G - C
+  std::vector<int> dist_b; // population distance from b in G - C
+  std::vector<int> touched;
+  std::vector<std::pair<int, int>> through; // (from a side, from b side) per member of C
+  cut_scratch(int n, int infty) : in_cc(n, 0), visited(n, 0), aci(n, 0), in_c(n, 0), epoch(0), dist(n, infty), dist_b(n, infty)
+  {
+    s.reserve(n);
+  }
+  unsigned int next_epoch()
+  {
+    if (++epoch == 0) // wrapped around, old marks could match again
+    {
+      std::fill(in_cc.begin(), in_cc.end(), 0);
+      std::fill(visited.begin(), visited.end(), 0);
+      std::fill(aci.begin(), aci.end(), 0);
+      std::fill(in_c.begin(), in_c.end(), 0);
+      epoch = 1;
+    }
+    return epoch;
+  }
+};
+
+// a lazy cut sum_{c in C} x_cb >= x_ab found for center b
+struct found_cut
+{
+  int a;
+  std::vector<int> C;
+};
 
 class CutCallback : public HessCallback
 {
   // memory for a callback
 private:
-  int* visited; // dfs marks
-  int* aci; // A(C_b) set
-  std::vector<int> s; // stack for DFS
-  std::vector<int> cc; // connected component for a vertex
-  std::vector<int> dist;
+  std::vector<cut_scratch> scratch; // one per thread
+  thread_pool workers;
+  std::vector<int> first; // members of district b are member[first[b] .. first[b+1])
+  std::vector<int> member;
+  std::vector<int> pos; // fill position per district
+  std::vector<int> heads; // clusterheads of the current solution
+  std::vector<std::vector<found_cut>> found; // cuts per clusterhead, added in this order
+  struct lcut_memo { int a, b; std::vector<int> C, kept; };
+  std::unordered_multimap<unsigned long long, lcut_memo> memo; // (a, b, C) -> refined C
+  std::mutex memo_mutex;
   bool is_lcut;
   int U;
+  cut_pool* pool; // may be null
+  cut_pool lazy; // cuts added by addLazy in this solve
+  vertex_separator sep;
+  std::vector<std::vector<std::pair<int, double>>> column; // fractional x: column[b] = (i, x_ib)
+  std::vector<int> H;
+  std::vector<double> H_w;
 public:
-  CutCallback(hess_params& p, graph *g_, const vector<int>& pop_, bool is_lcut_, int U_) : HessCallback(p, g_, pop_), is_lcut(is_lcut_), U(U_)
+  CutCallback(hess_params& p, graph *g_, const vector<int>& pop_, bool is_lcut_, int U_, cut_pool* pool_, unsigned int nr_threads)
+    : HessCallback(p, g_, pop_), workers(nr_threads > 0 ? nr_threads - 1 : 0), is_lcut(is_lcut_), U(U_), pool(pool_), sep(g_)
   {
-    visited = new int[n];
-    aci = new int[n];
-    s.reserve(n);
-    cc.resize(n);
-    dist.resize(n);
+    scratch.assign(workers.size(), cut_scratch(n, p.infty));
+    first.resize(n + 1);
+    member.resize(n);
+    pos.resize(n);
   }
   virtual ~CutCallback()
   {
-    delete[] aci;
-    delete[] visited;
   }
 protected:
   void callback();
+  void separate(int b, cut_scratch& sc, std::vector<found_cut>& out);
+  void separate_fractional();
+  void sweep(int src, std::vector<int>& d, unsigned int e_sep, cut_scratch& sc);
+  void refine(int a, int b, unsigned int e_sep, cut_scratch& sc);
 };
 
+// population distances from src in G - C, capped at U since longer ones never matter
+void CutCallback::sweep(int src, std::vector<int>& d, unsigned int e_sep, cut_scratch& sc)
+{
+  using namespace std;
+  priority_queue< pair<int, int>, vector <pair<int, int>>, greater<pair<int, int>> > pq;
+  const vector<int>& pp = population;
+  d[src] = pp[src];
+  sc.touched.push_back(src);
+  pq.push(make_pair(d[src], src));
+  while (!pq.empty())
+  {
+    pair<int, int> top = pq.top(); pq.pop();
+    int u = top.second;
+    if (top.first > d[u])
+      continue;
+    for (int nb_u : g->nb(u))
+      if (sc.in_c[nb_u] != e_sep && d[u] + pp[nb_u] <= U && d[nb_u] > d[u] + pp[nb_u])
+      {
+        if (d[nb_u] == p.infty)
+          sc.touched.push_back(nb_u);
+        d[nb_u] = d[u] + pp[nb_u];
+        pq.push(make_pair(d[nb_u], nb_u));
+      }
+  }
+}
+
+// drop from the a-b separator C (marked in_c == e_sep) every vertex D such that each a-b path
+// avoiding C \ D is longer than U; a path meets D first in d1 and last in dk, so it is at least
+// A(d1) + B(dk) with A(d) = dist_a(N(d)) + p[d] and B(d) = p[d] + dist_b(N(d)), or A(d) + B(d) - p[d]
+// when d1 = dk, and D is valid if both min A + min B and each A(d) + B(d) - p[d] exceed U
+void CutCallback::refine(int a, int b, unsigned int e_sep, cut_scratch& sc)
+{
+  using namespace std;
+  sort(sc.C.begin(), sc.C.end());
+  unsigned long long key = separator_hash(a, b, sc.C);
+  {
+    lock_guard<mutex> lock(memo_mutex);
+    auto range = memo.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+      if (it->second.a == a && it->second.b == b && it->second.C == sc.C)
+      {
+        sc.C = it->second.kept;
+        return;
+      }
+  }
+
+  const vector<int>& pp = population;
+  sweep(a, sc.dist, e_sep, sc);
+  sweep(b, sc.dist_b, e_sep, sc);
+  sc.through.resize(sc.C.size());
+  for (size_t t = 0; t < sc.C.size(); ++t)
+  {
+    int c = sc.C[t];
+    int da = p.infty, db = p.infty;
+    for (int nb_c : g->nb(c))
+    {
+      da = min(da, sc.dist[nb_c]);
+      db = min(db, sc.dist_b[nb_c]);
+    }
+    // infty marks too far, keep the sums from overflowing
+    sc.through[t].first = da >= p.infty ? p.infty : da + pp[c];
+    sc.through[t].second = db >= p.infty ? p.infty : db + pp[c];
+  }
+  for (int v : sc.touched)
+    sc.dist[v] = sc.dist_b[v] = p.infty;
+  sc.touched.clear();
+
+  // D(t) = {d : A(d) >= t, B(d) > U - t, A(d) + B(d) - p[d] > U}, try every A as threshold
+  int best = 0;
+  long long best_t = 0;
+  for (size_t s_t = 0; s_t < sc.C.size(); ++s_t)
+  {
+    long long thr = sc.through[s_t].first;
+    int cnt = 0;
+    for (size_t t = 0; t < sc.C.size(); ++t)
+      if (sc.through[t].first >= thr && sc.through[t].second > U - thr
+          && static_cast<long long>(sc.through[t].first) + sc.through[t].second - pp[sc.C[t]] > U)
+        ++cnt;
+    if (cnt > best)
+    {
+      best = cnt;
+      best_t = thr;
+    }
+  }
+  lcut_memo entry;
+  entry.a = a; entry.b = b; entry.C = sc.C;
+  if (best > 0)
+    for (size_t t = 0; t < sc.C.size(); )
+    {
+      if (sc.through[t].first >= best_t && sc.through[t].second > U - best_t
+          && static_cast<long long>(sc.through[t].first) + sc.through[t].second - pp[sc.C[t]] > U)
+      {
+        sc.in_c[sc.C[t]] = 0;
+        sc.C[t] = sc.C.back();
+        sc.C.pop_back();
+        sc.through[t] = sc.through.back();
+        sc.through.pop_back();
+      }
+      else
+        ++t;
+    }
+  entry.kept = sc.C;
+  lock_guard<mutex> lock(memo_mutex);
+  if (memo.size() >= LcutMemoMax)
+    memo.clear();
+  memo.emplace(key, std::move(entry));
+}
+
+// user cuts sum_{c in C} x_cb >= x_ab for the node relaxation, C a minimum weight a-b separator
+// with weights x_cb, found by max-flow; within UserCutsPerNode cuts and UserCutTimePerNode seconds
+void CutCallback::separate_fractional()
+{
+  using namespace std;
+  cut_scratch& sc = scratch[0];
+  auto start = chrono::steady_clock::now();
+  int nr_var = static_cast<int>(p.h.size());
+  double* x = getNodeRel(p.x, nr_var);
+  for (auto& col : column)
+    col.clear();
+  column.resize(n);
+  for (int v = 0; v < nr_var; ++v)
+    if (x[v] > 1e-6)
+      column[p.h.column(v)].push_back(make_pair(p.h.row(v), x[v]));
+  delete[] x;
+
+  int nr_cuts = 0;
+  for (int b = 0; b < n && nr_cuts < UserCutsPerNode; ++b)
+  {
+    if (column[b].empty())
+      continue;
+    double x_bb = 0.;
+    H.clear(); H_w.clear();
+    for (auto& e : column[b])
+    {
+      if (e.first == b)
+        x_bb = e.second;
+      H.push_back(e.first);
+      H_w.push_back(e.second);
+    }
+    if (x_bb < UserCutMinX)
+      continue;
+    sep.build(H, H_w);
+    unsigned int e_nb = sc.next_epoch();
+    sc.aci[b] = e_nb;
+    for (int nb : g->nb(b))
+      sc.aci[nb] = e_nb; // adjacent to b, no separator
+    for (auto& e : column[b])
+    {
+      int a = e.first;
+      double x_ab = e.second;
+      if (sc.aci[a] == e_nb || x_ab < UserCutMinX)
+        continue;
+      double flow = sep.max_flow(a, b, x_ab);
+      if (flow < x_ab - UserCutViolation)
+      {
+        sep.separator(a, sc.C, sc.visited, sc.next_epoch());
+        GRBLinExpr expr = 0;
+        for (int c : sc.C)
+          expr += X(c, b);
+        expr -= X(a, b);
+        addCut(expr >= 0);
+        ++numUserCuts;
+        if (pool)
+          pool->add(a, b, sc.C);
+        if (++nr_cuts >= UserCutsPerNode)
+          break;
+      }
+      chrono::duration<double> d = chrono::steady_clock::now() - start;
+      if (d.count() > UserCutTimePerNode)
+        return;
+    }
+  }
+}
+
+// adds a cut for every component of district b not connected to b
+void CutCallback::separate(int b, cut_scratch& sc, std::vector<found_cut>& out)
+{
+  using namespace std;
+
+  // run DFS from b on C_b, compute A(C_b) to save time later
+  unsigned int e_b = sc.next_epoch();
+  sc.s.clear(); sc.s.push_back(b); sc.in_cc[b] = e_b;
+  while (!sc.s.empty())
+  {
+    int cur = sc.s.back(); sc.s.pop_back();
+    for (int nb_cur : g->nb(cur))
+      if (assign[nb_cur] == b) // if nb_cur is in C_b
+      {
+        if (sc.in_cc[nb_cur] != e_b)
+        {
+          sc.in_cc[nb_cur] = e_b;
+          sc.s.push_back(nb_cur);
+        }
+      }
+      else sc.aci[nb_cur] = e_b; // nb_cur is a neighbor of a vertex in C_b, thus in A(C_b)
+  }
+
+  // here if C_b is connected, all vertices in C_b must be visited
+  // since we want to add cut for every connected component reamining there, every member not seen yet starts one
+  for (int t = first[b]; t < first[b + 1]; ++t)
+  {
+    int j = member[t];
+    if (sc.in_cc[j] == e_b)
+      continue;
+    unsigned int e_cc = do_reverse_nb ? sc.next_epoch() : e_b; // A(cc) replaces A(C_b)
+    int cc_max_pop_node = j;
+    //run dfs from j and mark cc
+    sc.s.clear(); sc.s.push_back(j); sc.in_cc[j] = e_b;
+    while (!sc.s.empty())
+    {
+      int cur = sc.s.back(); sc.s.pop_back();
+      for (int nb_cur : g->nb(cur))
+        if (assign[nb_cur] == b)
+        {
+          if (sc.in_cc[nb_cur] != e_b)
+          {
+            sc.in_cc[nb_cur] = e_b;
+            sc.s.push_back(nb_cur);
+            if (population[nb_cur] > population[cc_max_pop_node])
+              cc_max_pop_node = nb_cur;
+          }
+        } else if(do_reverse_nb) sc.aci[nb_cur] = e_cc;
+    }
+    // work with cc_max_pop_node
+    int a = cc_max_pop_node; // shorted alias
+    // compute a-b separator inside A(.), stops at the separator so only the component is explored
+    unsigned int e_sep = sc.next_epoch();
+    sc.C.clear();
+    sc.s.clear();
+    int separator_start = do_reverse_nb ? a : b;
+    sc.s.push_back(separator_start); sc.visited[separator_start] = e_sep;
+    while (!sc.s.empty())
+    {
+      int cur = sc.s.back(); sc.s.pop_back();
+      for (int nb_cur : g->nb(cur))
+      {
+        if (sc.visited[nb_cur] != e_sep)
+        {
+          sc.visited[nb_cur] = e_sep;
+          if (sc.aci[nb_cur] == e_cc)
+          {
+            sc.C.push_back(nb_cur);
+            sc.in_c[nb_cur] = e_sep;
+          }
+          else sc.s.push_back(nb_cur);
+        }
+      }
+    }
+    if (is_lcut)
+      refine(a, b, e_sep, sc);
+    out.push_back(found_cut{a, sc.C});
+  }
+}
+
 void CutCallback::callback()
 {
   using namespace std;
   try
   {
-    if (where == GRB_CB_MIPSOL)
+    if (where == GRB_CB_MIPNODE && getIntInfo(GRB_CB_MIPNODE_STATUS) == GRB_OPTIMAL)
+    {
+      ++numNodeCallbacks;
+      auto start = chrono::steady_clock::now();
+      separate_fractional();
+      chrono::duration<double> d = chrono::steady_clock::now() - start;
+      callbackTime += d.count();
+    }
+    else if (where == GRB_CB_MIPSOL)
     {
       ++numCallbacks;
       auto start = chrono::steady_clock::now();
 
-      populate_x(); // from HessCallback
+      populate_assign(); // from HessCallback
 
-      // try clusterheads
+      // districts as member lists (counting sort by center)
+      fill(first.begin(), first.end(), 0);
+      for (int i = 0; i < n; ++i)
+        if (assign[i] >= 0)
+          first[assign[i] + 1]++;
       for (int b = 0; b < n; ++b)
+        first[b + 1] += first[b];
+      copy(first.begin(), first.end() - 1, pos.begin());
+      for (int i = 0; i < n; ++i)
+        if (assign[i] >= 0)
+          member[pos[assign[i]]++] = i;
+
+      // try clusterheads, each on its own thread; Gurobi is only called from this one
+      heads.clear();
+      for (int b = 0; b < n; ++b)
+        if (assign[b] == b) // b is a clusterhead
+          heads.push_back(b);
+      found.resize(heads.size());
+      workers.run(heads.size(), [this](unsigned int t, unsigned int tid) {
+        found[t].clear();
+        separate(heads[t], scratch[tid], found[t]);
+      });
+      // cuts added earlier in this solve are skipped; Gurobi may still present a solution violating them,
+      // so one is added again if nothing new cuts it off
+      int nr_added = 0;
+      const found_cut* seen = nullptr;
+      int seen_b = -1;
+      auto add_cut = [&](const found_cut& cut, int b) {
+        GRBLinExpr expr = 0;
+        for (int c : cut.C)
+          expr += X(c, b);
+        expr -= X(cut.a, b); // RHS
+        addLazy(expr >= 0);
+        ++numLazyCuts;
+        ++nr_added;
+      };
+      for (size_t t = 0; t < heads.size(); ++t)
       {
-        if (x_val[b][b] > 0.5) // b is a clusterhead
+        int b = heads[t];
+        for (found_cut& cut : found[t])
         {
-          // run DFS from b on C_b, compute A(C_b) to save time later
-          // clean A(C_b) and visited
-          for (int j = 0; j < n; ++j)
-          {
-            aci[j] = 0;
-            visited[j] = 0;
-          }
-
-          // run DFS on C_b
-          s.clear(); s.push_back(b); visited[b] = 1;
-          while (!s.empty())
+          if (pool)
+            pool->add(cut.a, b, cut.C);
+          if (lazy.add(cut.a, b, cut.C))
+            add_cut(cut, b);
+          else if (!seen)
           {
-            int cur = s.back(); s.pop_back();
-            for (int nb_cur : g->nb(cur))
-              if (x_val[nb_cur][b] > 0.5) // if nb_cur is in C_b
-              {
-                if (!visited[nb_cur])
-                {
-                  visited[nb_cur] = 1;
-                  s.push_back(nb_cur);
-                }
-              }
-              else aci[nb_cur] = 1; // nb_cur is a neighbor of a vertex in C_b, thus in A(C_b)
+            seen = &cut;
+            seen_b = b;
           }
-
-          // here if C_b is connected, all vertices in C_b must be visited
-          // since we want to add cut for every connected component reamining there, we will mark cc's
-          int cur_cc = 0;
-          fill(cc.begin(), cc.end(), 0);
-          for (int j = 0; j < n; ++j)
-            if (x_val[j][b] > 0.5 && !visited[j] && cc[j] == 0)
-            {
-              int cc_max_pop_node = j;
-              if(do_reverse_nb)
-                for(int i = 0; i < n; ++i)
-                  aci[i] = 0;
-              //run dfs from j and mark cc
-              cur_cc++; // we don't really need info about cc # but it is neat to have it
-              s.clear(); s.push_back(j); cc[j] = cur_cc;
-              while (!s.empty())
-              {
-                int cur = s.back(); s.pop_back();
-                for (int nb_cur : g->nb(cur))
-                  if (x_val[nb_cur][b] > 0.5)
-                  {
-                    if(!visited[nb_cur] && cc[nb_cur] == 0)
-                    {
-                      cc[nb_cur] = cur_cc;
-                      s.push_back(nb_cur);
-                      if (population[nb_cur] > population[cc_max_pop_node])
-                        cc_max_pop_node = nb_cur;
-                    }
-                  } else if(do_reverse_nb) aci[nb_cur] = 1;
-              }
-              // work with cc_max_pop_node
-              int a = cc_max_pop_node; // shorted alias
-              // compute i-j separator, A(C_b) is already computed)
-              GRBLinExpr expr = 0;
-              unordered_set<int> C;
-              // start DFS from j to find R_i
-              for (int k = 0; k < n; ++k)
-                visited[k] = 0;
-              s.clear();
-              int separator_start = do_reverse_nb ? a : b;
-              s.push_back(separator_start); visited[separator_start] = 1;
-              while (!s.empty())
-              {
-                int cur = s.back(); s.pop_back();
-                for (int nb_cur : g->nb(cur))
-                {
-                  if (!visited[nb_cur])
-                  {
-                    visited[nb_cur] = 1;
-                    if (aci[nb_cur]) C.insert(nb_cur); else s.push_back(nb_cur);
-                  }
-                }
-              }
-              if (is_lcut)
-              {
-                // refine set C
-                for (auto it_c = C.begin(); it_c != C.end(); )
-                {
-                  int c = *it_c;
-                  // find distance from a to b through c but not remaining C
-                  // priority queue Dijkstra
-                  // priority queue pair is <weight, vertex>, min weight on top
-                  priority_queue< pair<int, int>, vector <pair<int, int>>, greater<pair<int, int>> > pq;
-                  fill(dist.begin(), dist.end(), p.infty);
-                  const vector<int>& p = population; // alias
-                  pq.push(make_pair(p[a], a));
-                  dist[a] = p[a];
-                  while (!pq.empty())
-                  {
-                    int u = pq.top().second; pq.pop();
-                    for (int nb_u : g->nb(u))
-                    {
-                      if ((nb_u == c || C.count(nb_u) == 0) && dist[nb_u] > dist[u] + p[nb_u])
-                      {
-                        dist[nb_u] = dist[u] + p[nb_u];
-                        pq.push(make_pair(dist[nb_u], nb_u));
-                      }
-                    }
-                  }
-                  if (dist[b] > U)
-                    it_c = C.erase(it_c);
-                  else
-                    ++it_c;
-                }
-              }
-              for (int c : C)
-                expr += X(c, b);
-              expr -= X(a, b); // RHS
-              addLazy(expr >= 0);
-              ++numLazyCuts;
-            } // if
         }
       }
+      if (nr_added == 0 && seen)
+        add_cut(*seen, seen_b);
+
       chrono::duration<double> d = chrono::steady_clock::now() - start;
       callbackTime += d.count();
     }
@@ -188,51 +642,25 @@ void CutCallback::callback()
   }
 }
 
-HessCallback* build_cut_(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, bool is_lcut, int U)
+HessCallback* build_cut_(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, bool is_lcut, int U, cut_pool* pool, unsigned int nr_threads)
 {
   model->set(GRB_IntParam_LazyConstraints, 1); // turns off presolve!!!
-  CutCallback* cb = new CutCallback(p, g, population, is_lcut, U);
+  model->set(GRB_IntParam_PreCrush, 1); // user cuts are in terms of the original model
+  if (pool && pool->size() > 0)
+    cout << "Number of pooled cuts injected = " << pool->inject(model, p) << " of " << pool->size() << endl;
+  CutCallback* cb = new CutCallback(p, g, population, is_lcut, U, pool, nr_threads);
   model->setCallback(cb);
   model->update();
   return cb;
 }
 
-HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population)
+HessCallback* build_cut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, cut_pool* pool, unsigned int nr_threads)
 {
-  return build_cut_(model, p, g, population, false, 0);
+  return build_cut_(model, p, g, population, false, 0, pool, nr_threads);
 }
-HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U)
+HessCallback* build_lcut(GRBModel* model, hess_params& p, graph* g, const vector<int>& population, int U, cut_pool* pool, unsigned int nr_threads)
 {
-  // fix x_ab=0 if dist_{G,p}(a,b)>U 
-  vector<int> dist(g->nr_nodes);
-  int countFixed = 0;
-  for (int b = 0; b < g->nr_nodes; ++b)
-  {
-    // compute population-weighted distance from a to all other nodes.
-    priority_queue< pair<int, int>, vector <pair<int, int>>, greater<pair<int, int>> > pq;
-    fill(dist.begin(), dist.end(), p.infty);
-    pq.push(make_pair(population[b], b));
-    dist[b] = population[b];
-    while (!pq.empty())
-    {
-      int u = pq.top().second; pq.pop();
-      for (int nb_u : g->nb(u))
-      {
-        if (dist[nb_u] > dist[u] + population[nb_u])
-        {
-          dist[nb_u] = dist[u] + population[nb_u];
-          pq.push(make_pair(dist[nb_u], nb_u));
-        }
-      }
-    }
-    for (int a = 0; a < g->nr_nodes; ++a)
-      if (dist[a] > U && IS_X(a, b))
-      {
-        model->addConstr(X_V(a, b) == 0);
-        countFixed++;
-      }
-  }
-  cout << "Number of vars fixed in lcut initialization = " << countFixed << endl;
-
-  return build_cut_(model, p, g, population, true, U);
+  // x_ab with dist_{G,p}(a,b) > U are fixed by the caller: fix_population_distance before build_hess for the
+  // main model, bounds in ContiguityHeuristic for the restricted one
+  return build_cut_(model, p, g, population, true, U, pool, nr_threads);
 }
@@ -0,0 +1,94 @@
+// source file for the variable fixing matrix
+#include <algorithm>
+#include <queue>
+#include <atomic>
+#include <climits>
+
+#include "districting/fixing.hpp"
+#include "districting/graph.hpp"
+#include "districting/parallel.hpp"
+
+using namespace std;
+
+void fixing_matrix::resize(int n_)
+{
+  n = n_;
+  words = (n + 63) / 64;
+  zero.assign(n * words, 0);
+  one.assign(n * words, 0);
+  tail = (n % 64 == 0) ? ~uint64_t(0) : (uint64_t(1) << (n % 64)) - 1;
+}
+
+void fixing_matrix::restrict_columns(const vector<int>& columns)
+{
+  // one row pattern, copied to every row
+  vector<uint64_t> row(words, ~uint64_t(0));
+  if (words > 0)
+    row[words - 1] = tail;
+  for (int j : columns)
+    row[j >> 6] &= ~(uint64_t(1) << (j & 63));
+  for (size_t i = 0; i < n; ++i)
+    copy(row.begin(), row.end(), zero.begin() + i * words);
+  fill(one.begin(), one.end(), 0);
+}
+
+size_t fixing_matrix::count_zero() const
+{
+  size_t cnt = 0;
+  for (uint64_t m : zero)
+    cnt += __builtin_popcountll(m);
+  return cnt;
+}
+
+size_t fixing_matrix::count_one() const
+{
+  size_t cnt = 0;
+  for (uint64_t m : one)
+    cnt += __builtin_popcountll(m);
+  return cnt;
+}
+
+size_t fix_population_distance(fixing_matrix& F, graph* g, const vector<int>& population, int U, unsigned int nr_threads)
+{
+  int n = g->nr_nodes;
+  thread_pool pool(nr_threads > 0 ? nr_threads - 1 : 0);
+  vector<vector<int>> dist(pool.size(), vector<int>(n, INT_MAX));
+  vector<vector<int>> reached(pool.size());
+  atomic<size_t> countFixed(0);
+  // distances are symmetric, so the Dijkstra from a fixes row a and every thread writes its own rows
+  pool.run(n, [&](unsigned int a, unsigned int tid) {
+    vector<int>& d = dist[tid];
+    vector<int>& seen = reached[tid];
+    priority_queue< pair<int, int>, vector <pair<int, int>>, greater<pair<int, int>> > pq;
+    d[a] = population[a];
+    seen.push_back(a);
+    pq.push(make_pair(d[a], a));
+    while (!pq.empty())
+    {
+      pair<int, int> top = pq.top(); pq.pop();
+      int u = top.second;
+      if (top.first > d[u])
+        continue;
+      for (int nb_u : g->nb(u))
+        if (d[u] + population[nb_u] <= U && d[nb_u] > d[u] + population[nb_u])
+        {
+          if (d[nb_u] == INT_MAX)
+            seen.push_back(nb_u);
+          d[nb_u] = d[u] + population[nb_u];
+          pq.push(make_pair(d[nb_u], nb_u));
+        }
+    }
+    size_t cnt = 0;
+    for (int b = 0; b < n; ++b)
+      if (d[b] > U && !F.is_zero(a, b))
+      {
+        F.fix_zero(a, b);
+        ++cnt;
+      }
+    for (int v : seen)
+      d[v] = INT_MAX;
+    seen.clear();
+    countFixed += cnt;
+  });
+  return countFixed;
+}
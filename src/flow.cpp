@@ -1,165 +1,408 @@
 // source file for single and multi commodity flow formulations
-#include <unordered_map>
+#include <cstdio>
 #include <vector>
+#include <algorithm>
 
 #include "gurobi_c++.h"
 
 #include "districting/graph.hpp"
 #include "districting/models.hpp"
+#include "districting/builder.hpp"
 
 
+// nodes i that may still join center j (x_ij not fixed to 0) and are connected to j through such
+// nodes, j first; mark[i] == stamp for the nodes returned, other nodes keep their marks
+static void center_support(graph* g, const hess_params& p, int j, vector<int>& comp, vector<int>& mark, int stamp)
+{
+  comp.clear();
+  comp.push_back(j);
+  mark[j] = stamp;
+  for (size_t t = 0; t < comp.size(); ++t)
+    for (int nb : g->nb(comp[t]))
+      if (mark[nb] != stamp && !p.F->is_zero(nb, j))
+      {
+        mark[nb] = stamp;
+        comp.push_back(nb);
+      }
+}
+
+// SHIR commodity of center j on its support comp (mark[i] == stamp): flow variables on the arcs
+// inside the support, none into j (constraint (d)), and constraints (b) and (c) with M = |support| - 1;
+// x_ij = 0 forces in- and outflow of i to 0 by (b) and (c), so the arcs outside are left out.
+// returns the number of flow variables
+static int add_shir_commodity(GRBModel* model, hess_params& p, const arc_index& arcs, int j, const vector<int>& comp,
+  const vector<int>& mark, int stamp, vector<int>& local, row_builder& rows)
+{
+  int cur = 0;
+  for (int i : comp)
+    for (int a = arcs.off[i]; a < arcs.off[i + 1]; ++a)
+      if (mark[arcs.head[a]] == stamp && arcs.head[a] != j)
+        local[a] = cur++;
+  GRBVar* f = model->addVars(cur, GRB_CONTINUOUS);
+
+  for (size_t t = 1; t < comp.size(); ++t)
+  {
+    int i = comp[t];
+    for (int a = arcs.off[i]; a < arcs.off[i + 1]; ++a)
+      if (mark[arcs.head[a]] == stamp)
+      {
+        rows.add(f[local[arcs.rev[a]]], 1.); // in d^- : edge (nb_i -- i)
+        if (arcs.head[a] != j)
+          rows.add(f[local[a]], -1.); // in d^+ : edge (i -- nb_i)
+      }
+    rows.add_x(p, i, j, -1.);
+    rows.end(GRB_EQUAL, 0.);
+
+    for (int a = arcs.off[i]; a < arcs.off[i + 1]; ++a)
+      if (mark[arcs.head[a]] == stamp)
+        rows.add(f[local[arcs.rev[a]]], 1.); // in d^- : edge (nb_i -- i)
+    rows.add_x(p, i, j, -static_cast<double>(comp.size() - 1));
+    rows.end(GRB_LESS_EQUAL, 0.);
+  }
+  delete[] f;
+  return cur;
+}
+
 void build_shir(GRBModel* model, hess_params& p, graph* g)
 {
   int n = g->nr_nodes;
 
   vector<int> centers;
   for (int i = 0; i < n; ++i)
-    if (!p.F0[i][i])
+    if (!p.F->is_zero(i, i))
       centers.push_back(i);
 
   int c = centers.size();
 
-  // step 1 : hash edge (i,j) to i*n+j = h1
-  // step 2 : hash every h1 to a number, resulting in exactly |E| variables
-
-  std::unordered_map<int, int> hash_edges;
-  int cur = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j : g->nb(i))
-      hash_edges.insert(std::make_pair(i*n + j, cur++));
-
-  // get number of edges
-  int nr_edges = hash_edges.size();
-
-  // add flow variables f[v][i,j]
-  GRBVar**f = new GRBVar*[c]; // commodity type, v
-  for (int v = 0; v < c; ++v)
-    f[v] = model->addVars(nr_edges, GRB_CONTINUOUS); // the edge
+  // flow of commodity j only lives on the subgraph j can reach under the fixings
+  arc_index arcs(g);
+  vector<int> mark(n, -1);
+  vector<int> comp;
+  vector<int> local(arcs.nr_arcs(), -1); // arc -> flow variable of the current commodity
+  long nr_flow = 0;
+  int nr_unreachable = 0;
 
-  // add constraint (b)
+  row_builder rows(model);
   for (int v = 0; v < c; ++v)
   {
     int j = centers[v];
+    center_support(g, p, j, comp, mark, v);
+    nr_flow += add_shir_commodity(model, p, arcs, j, comp, mark, v, local, rows);
+
+    // i not connected to j inside the support cannot receive flow, so x_ij = 0
     for (int i = 0; i < n; ++i)
-    {
-      if (i == j) continue;
-      GRBLinExpr expr = 0;
-      for (int nb_i : g->nb(i))
+      if (mark[i] != v && !p.F->is_zero(i, j))
       {
-        expr += f[v][hash_edges[n*nb_i + i]]; // in d^- : edge (nb_i -- i)
-        expr -= f[v][hash_edges[n*i + nb_i]]; // in d^+ : edge (i -- nb_i)
+        rows.add_x(p, i, j, 1.);
+        rows.end(GRB_EQUAL, 0.);
+        nr_unreachable++;
       }
-      model->addConstr(expr == X(i, j));
-    }
   }
+  rows.flush();
+  printf("Build shir : %d commodities, %ld flow variables (%ld without fixings), %d x fixed by reachability\n",
+    c, nr_flow, static_cast<long>(c) * arcs.nr_arcs(), nr_unreachable);
+}
+
+// supports of all possible centers (see center_support), one selected at a time for membership tests
+struct flow_supports
+{
+  arc_index arcs;
+  vector<vector<int>> comp; // comp[b] is empty if b cannot be a center
+  vector<int> mark;
+  int stamp;
+  flow_supports(graph* g, const hess_params& p) : arcs(g), comp(g->nr_nodes), mark(g->nr_nodes, -1), stamp(0)
+  {
+    for (uint b = 0; b < g->nr_nodes; ++b)
+      if (!p.F->is_zero(b, b))
+        center_support(g, p, b, comp[b], mark, b);
+    stamp = g->nr_nodes;
+  }
+  void select(int b)
+  {
+    ++stamp;
+    for (int i : comp[b])
+      mark[i] = stamp;
+  }
+  bool in(int i) const { return mark[i] == stamp; }
+};
+
+// commodity (a,b): x_ab units from center b to a on the arcs inside the support of b (selected in s),
+// no flow into b and inflow of j at most x_jb; returns the number of flow variables
+static int add_mcf_commodity(GRBModel* model, hess_params& p, flow_supports& s, int a, int b,
+  vector<int>& local, row_builder& rows)
+{
+  const arc_index& arcs = s.arcs;
+  const vector<int>& comp = s.comp[b];
+  int cur = 0;
+  for (int i : comp)
+    for (int e = arcs.off[i]; e < arcs.off[i + 1]; ++e)
+      if (s.in(arcs.head[e]) && arcs.head[e] != b)
+        local[e] = cur++;
+  GRBVar* f = model->addVars(cur, GRB_CONTINUOUS);
+
+  // add constraint (b)
+  for (int e = arcs.off[b]; e < arcs.off[b + 1]; ++e)
+    if (s.in(arcs.head[e]))
+      rows.add(f[local[e]], 1.); // b -- j in d^+(b)
+  rows.add_x(p, a, b, -1.);
+  rows.end(GRB_EQUAL, 0.);
 
   // add constraint (c)
-  for (int v = 0; v < c; ++v)
+  for (int i : comp)
   {
-    int j = centers[v];
-    for (int i = 0; i < n; ++i)
-    {
-      if (i == j) continue;
-      GRBLinExpr expr = 0;
-      for (int nb_i : g->nb(i))
-        expr += f[v][hash_edges[n*nb_i + i]]; // in d^- : edge (nb_i -- i)
-      model->addConstr(expr <= (n - 1) * X(i, j));
-    }
+    if (i == a || i == b) continue;
+    for (int e = arcs.off[i]; e < arcs.off[i + 1]; ++e)
+      if (s.in(arcs.head[e]))
+      {
+        if (arcs.head[e] != b)
+          rows.add(f[local[e]], 1.);
+        rows.add(f[local[arcs.rev[e]]], -1.);
+      }
+    rows.end(GRB_EQUAL, 0.);
   }
 
-  // add constraint (d) -- actually just fix individual vars to zero
-  for (int v = 0; v < c; ++v)
+  // add constraint (19e)
+  for (int j : comp)
   {
-    int j = centers[v];
-    for (int i : g->nb(j))
-      f[v][hash_edges[n*i + j]].set(GRB_DoubleAttr_UB, 0.); // in d^+ : edge (nb_j -- j)
+    if (j == b) continue;
+    for (int e = arcs.off[j]; e < arcs.off[j + 1]; ++e)
+      if (s.in(arcs.head[e]))
+        rows.add(f[local[arcs.rev[e]]], 1.); // i -- j
+    rows.add_x(p, j, b, -1.);
+    rows.end(GRB_LESS_EQUAL, 0.);
   }
+  delete[] f;
+  return cur;
+}
+
+// x_ab = 0 for the a outside the support of b (selected in s)
+static int fix_unreachable(hess_params& p, flow_supports& s, int b, row_builder& rows)
+{
+  int cnt = 0;
+  for (int a = 0; a < p.n; ++a)
+    if (!s.in(a) && !p.F->is_zero(a, b))
+    {
+      rows.add_x(p, a, b, 1.);
+      rows.end(GRB_EQUAL, 0.);
+      cnt++;
+    }
+  return cnt;
 }
 
 void build_mcf(GRBModel* model, hess_params& p, graph* g)
 {
-    int n = g->nr_nodes;
+  int n = g->nr_nodes;
 
-    // hash edges similarly to mcf1
-    std::unordered_map<int, int> hash_edges;
-    int cur = 0;
-    for (int i = 0; i < n; ++i)
-        for (int j : g->nb(i))
-            hash_edges.insert(std::make_pair(i*n + j, cur++));
+  // commodities only for pairs (a,b) still free after fixing and not adjacent (adjacent a is connected to b)
+  flow_supports s(g, p);
+  vector<int> local(s.arcs.nr_arcs(), -1);
+  vector<bool> is_nb(n, false);
+  row_builder rows(model);
+  long nr_flow = 0;
+  int nr_commodities = 0;
+  int nr_unreachable = 0;
+  for (int b = 0; b < n; ++b)
+  {
+    if (s.comp[b].empty()) continue;
+    s.select(b);
+    for (int j : g->nb(b))
+      is_nb[j] = true;
+    for (int a : s.comp[b])
+      if (a != b && !is_nb[a])
+      {
+        nr_flow += add_mcf_commodity(model, p, s, a, b, local, rows);
+        nr_commodities++;
+      }
+    for (int j : g->nb(b))
+      is_nb[j] = false;
+    nr_unreachable += fix_unreachable(p, s, b, rows);
+  }
+  rows.flush();
+  printf("Build mcf : %d commodities, %ld flow variables, %d x fixed by reachability\n", nr_commodities, nr_flow, nr_unreachable);
+}
 
-    // get number of edges
-    int nr_edges = hash_edges.size();
+// rounds of LP solves before the MIP, each round adds the blocks the LP solution uses
+const int LazyFlowLpRounds = 20;
+// x values above this count as used in the LP rounds
+const double LazyFlowLpEps = 1e-6;
 
-    GRBVar ***f = new GRBVar**[n]; // f[ b ][ (i,j) ][ a ]
-    for (int i = 0; i < n; ++i)
-    {
-        f[i] = new GRBVar*[nr_edges];
-        for (int j = 0; j < nr_edges; ++j)
-            f[i][j] = model->addVars(n - g->nb(i).size() - 1, GRB_CONTINUOUS); // V = { i } u N(i) u (V \ N[i])
-    }
+void LazyFlow::optimize(GRBModel* model)
+{
+  int nr_var = static_cast<int>(p.h.size());
+  double time_left = model->get(GRB_DoubleParam_TimeLimit);
 
-    // preprocess V \ N[i] sets
-    std::vector<std::vector<int>> non_nbs(n);
+  // LP rounds on the relaxation of x
+  vector<char> vtype(nr_var, GRB_CONTINUOUS);
+  model->set(GRB_CharAttr_VType, p.x, vtype.data(), nr_var);
+  for (int round = 0; round < LazyFlowLpRounds && time_left > 0; ++round)
+  {
+    model->set(GRB_DoubleParam_TimeLimit, time_left);
+    model->optimize();
+    numRounds++;
+    time_left -= model->get(GRB_DoubleAttr_Runtime);
+    if (model->get(GRB_IntAttr_Status) != GRB_OPTIMAL)
+      break;
+    double* x = model->get(GRB_DoubleAttr_X, p.x, nr_var);
+    int added = add_blocks(model, x, LazyFlowLpEps);
+    delete[] x;
+    printf("Lazy flow LP round %d: objective %.2lf, %d blocks added\n", round, model->get(GRB_DoubleAttr_ObjVal), added);
+    if (added == 0)
+      break;
+  }
+  fill(vtype.begin(), vtype.end(), GRB_BINARY);
+  model->set(GRB_CharAttr_VType, p.x, vtype.data(), nr_var);
 
-    for (int i = 0; i < n; ++i)
+  // the MIP optimum is optimal for the full model once it only uses built blocks
+  while (time_left > 0)
+  {
+    model->set(GRB_DoubleParam_TimeLimit, time_left);
+    model->optimize();
+    numRounds++;
+    time_left -= model->get(GRB_DoubleAttr_Runtime);
+    if (model->get(GRB_IntAttr_SolCount) == 0)
+      break;
+    double* x = model->get(GRB_DoubleAttr_X, p.x, nr_var);
+    int added = add_blocks(model, x, 0.5);
+    delete[] x;
+    printf("Lazy flow MIP round: %d blocks added\n", added);
+    if (added == 0)
+      return;
+  }
+  printf("WARNING: lazy flow stopped with blocks missing, the incumbent may not be contiguous\n");
+}
+
+// MCF with the commodities added by LazyFlow::optimize
+class LazyMCF : public LazyFlow
+{
+private:
+  flow_supports s;
+  vector<int> local;
+  vector<vector<bool>> built; // built[b][a], allocated for possible centers
+protected:
+  int add_blocks(GRBModel* model, const double* x, double eps)
+  {
+    row_builder rows(model);
+    int added = 0;
+    for (int b = 0; b < p.n; ++b)
     {
-        std::vector<bool> nb(n, false);
-        nb[i] = true;
-        for (int j : g->nb(i))
-            nb[j] = true;
-        nb.flip();
-        for (int j = 0; j < n; ++j)
-            if (nb[j])
-                non_nbs[i].push_back(j);
-
-        // check
-        if (non_nbs[i].size() != n - 1 - g->nb(i).size())
-            throw "Internal Error : non nb size for mcf2";
+      if (s.comp[b].empty()) continue;
+      bool selected = false;
+      for (int a : s.comp[b])
+        if (!built[b][a] && IS_X(a, b) && x[X_I(a, b)] > eps)
+        {
+          if (!selected)
+          {
+            s.select(b);
+            selected = true;
+          }
+          add_mcf_commodity(model, p, s, a, b, local, rows);
+          built[b][a] = true;
+          added++;
+        }
+    }
+    rows.flush();
+    model->update();
+    numBlocks += added;
+    return added;
+  }
+public:
+  LazyMCF(GRBModel* model, hess_params& p_, graph* g_) : LazyFlow(p_, g_), s(g_, p_), local(s.arcs.nr_arcs(), -1), built(g_->nr_nodes)
+  {
+    row_builder rows(model);
+    int nr_unreachable = 0;
+    for (int b = 0; b < p.n; ++b)
+    {
+      if (s.comp[b].empty()) continue;
+      built[b].assign(p.n, false);
+      built[b][b] = true;
+      for (int j : g->nb(b))
+        built[b][j] = true; // adjacent, nothing to check
+      s.select(b);
+      nr_unreachable += fix_unreachable(p, s, b, rows);
     }
+    rows.flush();
+    printf("Build lmcf : commodities added lazily, %d x fixed by reachability\n", nr_unreachable);
+  }
+};
 
-    // add constraint (b)
-    for (int b = 0; b < n; ++b)
-        for (int a_i = 0; a_i < n - 1 - g->nb(b).size(); ++a_i)
+LazyFlow* build_lmcf(GRBModel* model, hess_params& p, graph* g)
+{
+  return new LazyMCF(model, p, g);
+}
+
+// SHIR with the commodity of a center added by LazyFlow::optimize once the district of the
+// center (nodes with x_ij > eps) is not connected inside itself
+class LazySHIR : public LazyFlow
+{
+private:
+  flow_supports s;
+  vector<int> local;
+  vector<bool> built; // per center
+  vector<int> seen; // dfs marks, seen[i] == stamp
+  int stamp;
+  vector<int> stack;
+  // whether the nodes i with value x_ij > eps (or x_ij fixed to 1) are connected to j among themselves
+  bool connected(const double* x, double eps, int j)
+  {
+    auto in = [&](int i) { return p.F->is_one(i, j) || (IS_X(i, j) && x[X_I(i, j)] > eps); };
+    ++stamp;
+    stack.clear();
+    stack.push_back(j);
+    seen[j] = stamp;
+    while (!stack.empty())
+    {
+      int cur = stack.back(); stack.pop_back();
+      for (int nb : g->nb(cur))
+        if (seen[nb] != stamp && in(nb))
         {
-            GRBLinExpr expr = 0;
-            for (int j : g->nb(b))
-            {
-                expr += f[b][hash_edges[b*n + j]][a_i]; // b -- j in d^+(b)
-                expr -= f[b][hash_edges[j*n + b]][a_i]; // j -- b in d^-(b)
-            }
-            model->addConstr(expr == X(non_nbs[b][a_i],b));
+          seen[nb] = stamp;
+          stack.push_back(nb);
         }
+    }
+    for (int i : s.comp[j])
+      if (seen[i] != stamp && in(i))
+        return false;
+    return true;
+  }
+protected:
+  int add_blocks(GRBModel* model, const double* x, double eps)
+  {
+    row_builder rows(model);
+    int added = 0;
+    for (int j = 0; j < p.n; ++j)
+    {
+      if (built[j] || s.comp[j].empty() || !IS_X(j, j) || x[X_I(j, j)] <= eps)
+        continue;
+      if (connected(x, eps, j))
+        continue;
+      s.select(j);
+      add_shir_commodity(model, p, s.arcs, j, s.comp[j], s.mark, s.stamp, local, rows);
+      built[j] = true;
+      added++;
+    }
+    rows.flush();
+    model->update();
+    numBlocks += added;
+    return added;
+  }
+public:
+  LazySHIR(GRBModel* model, hess_params& p_, graph* g_) : LazyFlow(p_, g_), s(g_, p_), local(s.arcs.nr_arcs(), -1),
+    built(g_->nr_nodes, false), seen(g_->nr_nodes, 0), stamp(0)
+  {
+    row_builder rows(model);
+    int nr_unreachable = 0;
+    for (int j = 0; j < p.n; ++j)
+    {
+      if (s.comp[j].empty()) continue;
+      s.select(j);
+      nr_unreachable += fix_unreachable(p, s, j, rows);
+    }
+    rows.flush();
+    printf("Build lshir : commodities added lazily, %d x fixed by reachability\n", nr_unreachable);
+  }
+};
 
-    // add constraint (c)
-    for (int b = 0; b < n; ++b)
-        for (int a_i = 0; a_i < n - 1 - g->nb(b).size(); ++a_i)
-            for (int i = 0; i < n; ++i)
-            {
-                if (i == non_nbs[b][a_i] || i == b) continue;
-                GRBLinExpr expr = 0;
-                for (int j : g->nb(i))
-                {
-                    expr += f[b][hash_edges[i*n + j]][a_i];
-                    expr -= f[b][hash_edges[j*n + i]][a_i];
-                }
-                model->addConstr(expr == 0);
-            }
-
-    // add constraint (d) -- actually just fix each var UB to zero
-    for (int b = 0; b < n; ++b)
-        for (int a_i = 0; a_i < n - 1 - g->nb(b).size(); ++a_i)
-            for (int j : g->nb(b))
-                f[b][hash_edges[j*n + b]][a_i].set(GRB_DoubleAttr_UB, 0.); // j -- b
-
-    // add constraint (19e)
-    for (int b = 0; b < n; ++b)
-        for (int a_i = 0; a_i < n - 1 - g->nb(b).size(); ++a_i)
-            for (int j = 0; j < n; ++j)
-            {
-                if (j == b) continue;
-                GRBLinExpr expr = 0;
-                for (int i : g->nb(j))
-                    expr += f[b][hash_edges[i*n + j]][a_i]; // i -- j
-                model->addConstr(expr <= X(j,b));
-            }
+LazyFlow* build_lshir(GRBModel* model, hess_params& p, graph* g)
+{
+  return new LazySHIR(model, p, g);
 }
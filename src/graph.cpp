@@ -288,3 +288,29 @@ int graph::get_k() const
   };
   return k;
 }
+
+arc_index::arc_index(graph* g) : off(g->nr_nodes + 1, 0)
+{
+    uint n = g->nr_nodes;
+    for (uint i = 0; i < n; ++i)
+        off[i + 1] = off[i] + g->nb(i).size();
+    head.resize(off[n]);
+    rev.resize(off[n]);
+    for (uint i = 0; i < n; ++i)
+        for (uint t = 0; t < g->nb(i).size(); ++t)
+            head[off[i] + t] = g->nb(i)[t];
+    for (uint i = 0; i < n; ++i)
+        for (int a = off[i]; a < off[i + 1]; ++a)
+        {
+            uint j = head[a];
+            if (j < i)
+                continue;
+            for (int b = off[j]; b < off[j + 1]; ++b)
+                if (static_cast<uint>(head[b]) == i)
+                {
+                    rev[a] = b;
+                    rev[b] = a;
+                    break;
+                }
+        }
+}
@@ -4,12 +4,17 @@
 #include <algorithm>
 #include <unordered_set>
 #include <string>
+#include <random>
+#include <functional>
 
 #include "gurobi_c++.h"
 
 #include "districting/graph.hpp"
 #include "districting/models.hpp"
 #include "districting/io.hpp"
+#include "districting/builder.hpp"
+#include "districting/assign.hpp"
+#include "districting/parallel.hpp"
 
 using namespace std;
 
@@ -20,13 +25,14 @@ double get_objective_coefficient(const vector<vector<int>>& dist, const vector<i
 
 // adds hess model constraints and the objective function to model using graph "g", distance data "dist", population data "pop"
 // returns "x" variables in the Hess model
-hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, cvv& F0, cvv& F1)
+hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k,
+  const shared_ptr<fixing_matrix>& F)
 {
   // create GUROBI Hess model
   int n = g->nr_nodes;
   hess_params p;
   p.n = n;
-  p.F0 = F0; p.F1 = F1; // copy
+  p.F = F;
 
   // used in Cut callbacks
   p.infty = 1;
@@ -34,12 +40,18 @@ hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >&
     p.infty += population[i];
 
 
-  // hash variables
-  int cur = 0;
+  // index variables, columns fixed entirely take no space
+  vector<uint64_t> used(F->nr_words(), 0);
   for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      if (!F0[i][j] && !F1[i][j])
-        p.h[n*i + j] = cur++; //FIXME implicit reuse of the map (i,j) -> n*i+j
+    for (size_t w = 0; w < used.size(); ++w)
+      used[w] |= F->free_word(i, w);
+  vector<int> columns;
+  for (int j = 0; j < n; ++j)
+    if ((used[j >> 6] >> (j & 63)) & 1)
+      columns.push_back(j);
+  p.h.reset(n, columns);
+  for (int i = 0; i < n; ++i)
+    F->for_free(i, [&](int j) { p.h.add(i, j); });
 
   printf("Build hess : created %lu variables\n", p.h.size());
   int nr_var = static_cast<int>(p.h.size());
@@ -49,52 +61,56 @@ hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >&
   model->update();
 
   // Set objective: minimize sum d^2_ij*x_ij
-  GRBLinExpr expr = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      expr += w[i][j] * X(i, j);
+  set_hess_obj(model, p, w);
 
-  model->setObjective(expr, GRB_MINIMIZE);
+  row_builder rows(model);
 
   // add constraints (b)
   for (int i = 0; i < n; ++i)
   {
-    GRBLinExpr constr = 0;
     for (int j = 0; j < n; ++j)
-      constr += X(i, j);
-    model->addConstr(constr == 1);
+      rows.add_x(p, i, j, 1.);
+    rows.end(GRB_EQUAL, 1.);
   }
 
   // add constraint (c)
-  expr = 0;
   for (int j = 0; j < n; ++j)
-    expr += X(j, j);
-  model->addConstr(expr == k);
+    rows.add_x(p, j, j, 1.);
+  rows.end(GRB_EQUAL, k);
 
   // add aux constraint for (d) to reduce nonzeros number
   GRBVar* district_population = model->addVars(n, GRB_CONTINUOUS);
   model->update();
   for (int j = 0; j < n; ++j)
   {
-    GRBLinExpr constr = 0;
     for (int i = 0; i < n; ++i)
-      constr += population[i] * X(i, j);
-    model->addConstr(constr - district_population[j] == 0);
+      rows.add_x(p, i, j, population[i]);
+    rows.add(district_population[j], -1.);
+    rows.end(GRB_EQUAL, 0.);
   }
 
   // add constraint (d)
   for (int j = 0; j < n; ++j)
   {
-    model->addConstr(district_population[j] - U * X(j, j) <= 0); // U
-    model->addConstr(district_population[j] - L * X(j, j) >= 0); // L
+    rows.add(district_population[j], 1.); // U
+    rows.add_x(p, j, j, -U);
+    rows.end(GRB_LESS_EQUAL, 0.);
+    rows.add(district_population[j], 1.); // L
+    rows.add_x(p, j, j, -L);
+    rows.end(GRB_GREATER_EQUAL, 0.);
   }
 
   // add contraints (e)
   for (int i = 0; i < n; ++i)
     for (int j = 0; j < n; ++j)
-      if (i != j && !F0[i][j])
-        model->addConstr(X(i, j) <= X(j, j));
+      if (i != j && !F->is_zero(i, j))
+      {
+        rows.add_x(p, i, j, 1.);
+        rows.add_x(p, j, j, -1.);
+        rows.end(GRB_LESS_EQUAL, 0.);
+      }
 
+  rows.flush();
   model->update();
 
   //model->write("debug_hess.lp");
@@ -102,41 +118,24 @@ hess_params build_hess(GRBModel* model, graph* g, const vector<vector<double> >&
   return p;
 }
 
-// populate F0 and F1 depending on current centers
+// populate the fixings depending on current centers
 void populate_hess_params(hess_params& p, graph* g, const vector<int>& centers)
 {
   int n = g->nr_nodes; p.n = n;
-  int cur = 0;
-  p.h.clear();
+  p.h.reset(n, centers);
 
   //define x_ij for every for every j \in centers
   for (int j : centers)
     for (int i = 0; i < n; ++i)
-      p.h[n*i + j] = cur++;
+      p.h.add(i, j);
 
-  // clear F0 and F1
-  p.F0.resize(n); p.F1.resize(n);
-  for (int i = 0; i < n; ++i)
-  {
-    p.F0[i].resize(n); p.F1[i].resize(n);
-    fill(p.F0[i].begin(), p.F0[i].end(), false);
-    fill(p.F1[i].begin(), p.F1[i].end(), false);
-  }
-
-  // fill F0 and F1
-  //for(int j : centers)
-  //  p.F1[j][j] = true; // the centers fixed to 1
-  vector<bool> aux_F1(n, false);
-  for (int j : centers)
-    aux_F1[j] = true;
-
-  for (int j = 0; j < n; ++j)
-    if (!aux_F1[j])
-      for (int i = 0; i < n; ++i)
-        p.F0[i][j] = true; // other centers as well as corresponding i fixed to 0
+  // other centers as well as corresponding i fixed to 0
+  if (!p.F || p.F->size() != n)
+    p.F = make_shared<fixing_matrix>(n);
+  p.F->restrict_columns(centers);
 }
 
-#define ENSURE(i,j) {if(p.h.count(p.n*i+j)==0){fprintf(stderr,"ensure failed at line %d for i = %d, j = %d\n", __LINE__, i, j);exit(1);}}
+#define ENSURE(i,j) {if(!p.h.has(i,j)){fprintf(stderr,"ensure failed at line %d for i = %d, j = %d\n", __LINE__, i, j);exit(1);}}
 
 // adds hess model constraints and the objective function to model using graph "g", distance data "dist", population data "pop"
 // returns "x" variables in the Hess model
@@ -156,47 +155,52 @@ hess_params build_hess_restricted(GRBModel* model, graph* g, const vector<vector
   model->update();
 
   // recompute objective
-  for (int i = 0; i < n; ++i)
-    for (int j : centers)
-    {
-      ENSURE(i, j);
-      X_V(i, j).set(GRB_DoubleAttr_Obj, w[i][j]);
-    }
+  for (int j : centers)
+    set_column_obj(model, p, j, w, j);
+
+  row_builder rows(model);
 
   // add constraints (1b)
   for (int i = 0; i < n; ++i)
   {
-    GRBLinExpr constr = 0;
     for (int j : centers)
     {
       ENSURE(i, j);
-      constr += X(i, j);
+      rows.add_x(p, i, j, 1.);
     }
-    model->addConstr(constr == 1); // each i must be assigned to a center
+    rows.end(GRB_EQUAL, 1.); // each i must be assigned to a center
   }
 
   // add constraint (1d)
   for (int j : centers)
   {
-    GRBLinExpr constr = 0;
-    for (int i = 0; i < n; ++i)
+    // add for j
+    for (int l = 0; l < 2; ++l)
     {
-      ENSURE(i, j);
-      constr += population[i] * X(i, j);
+      for (int i = 0; i < n; ++i)
+      {
+        ENSURE(i, j);
+        rows.add_x(p, i, j, population[i]);
+      }
+      if (l == 0)
+        rows.end(GRB_LESS_EQUAL, U); // U
+      else
+        rows.end(GRB_GREATER_EQUAL, L); // L
     }
-    // add for j
-    model->addConstr(constr - U <= 0); // U
-    model->addConstr(constr - L >= 0); // L
   }
 
+  rows.flush();
   model->update();
 
   return p;
 }
 
 void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<vector<double> > &w,
-    const vector<int> &population, int L, int U, int k, double &UB, string arg_model)
+    const vector<int> &population, int L, int U, int k, double &UB, string arg_model, cut_pool* pool,
+    restricted_session* session)
 {
+    restricted_session own(g, w, population, L, U, k);
+    restricted_session& s = session ? *session : own;
     vector<int> centers;
 
     // find centers
@@ -256,43 +260,55 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
     HessCallback* cb = nullptr;
 
     try {
-        GRBEnv env = GRBEnv();
-        GRBModel model = GRBModel(env);
+        // the contiguity model and fixings below stay in the restricted model
+        GRBModel& model = s.restrict_to(centers);
+        s.extend();
+        hess_params& p = s.params();
         model.set(GRB_DoubleParam_TimeLimit, 3600.);
-
-        hess_params p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
-        populate_hess_params(p, g, centers); // now just use X(i,j), F0, F1 and more importantly hashtable are properly set up
+        model.set(GRB_IntParam_OutputFlag, 1);
+        model.set(GRB_DoubleParam_MIPGap, 1e-4);
 
         if (arg_model == "shir")
             build_shir(&model, p, g);
         else if (arg_model == "mcf")
             build_mcf(&model, p, g);
         else if (arg_model == "cut")
-            cb = build_cut(&model, p, g, population);
+            cb = build_cut(&model, p, g, population, pool);
         else if (arg_model == "lcut")
-            cb = build_lcut(&model, p, g, population, U);
+        {
+            // fix_population_distance only fixes the main model, so x_ab with dist_{G,p}(a,b) > U are fixed
+            // here by their bounds; p.F is shared with the variables and stays as it is
+            fixing_matrix D(g->nr_nodes);
+            fix_population_distance(D, g, population, U, 1);
+            int countFixed = 0;
+            for (int i = 0; i < g->nr_nodes; ++i)
+                for (int j : centers)
+                    if (D.is_zero(i, j) && IS_X(i, j))
+                    {
+                        X_V(i, j).set(GRB_DoubleAttr_UB, 0);
+                        countFixed++;
+                    }
+            cout << "Number of vars fixed by population distance in ContiguityHeuristic = " << countFixed << endl;
+            cb = build_lcut(&model, p, g, population, U, pool);
+        }
         else {
             fprintf(stderr, "ERROR: Unknown contiguity model : %s\n", arg_model.c_str());
             exit(1);
         }
 
-        // give a partial warm start where each vertex subset J is assigned to center j
+        // give a partial warm start where each vertex subset J is assigned to center j, nothing else is kept
+        // from the starts of earlier solves
+        vector<double> start(p.h.size(), GRB_UNDEFINED);
         for (int v = 0; v < J.size(); ++v)
         {
             int j = centers[v];
             for (int u = 0; u < J[v].size(); ++u)
             {
                 int i = J[v][u];
-                X_V(i, j).set(GRB_DoubleAttr_Start, 1);
+                start[X_I(i, j)] = 1;
             }
         }
-
-        // fix centers
-        for (int i = 0; i < k; ++i)
-        {
-            int v = centers[i];
-            X_V(v, v).set(GRB_DoubleAttr_LB, 1);
-        }  
+        model.set(GRB_DoubleAttr_Start, p.x, start.data(), static_cast<int>(start.size()));
 
         // fix interior of J to j when n>=200
         if(g->nr_nodes >= 200)
@@ -319,11 +335,10 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
             cout << endl;
 
             for (int i = 0; i < g->nr_nodes; ++i)
-                for (int j = 0; j < g->nr_nodes; ++j)
-                    if (p.F0[i][j])
-                        continue;
-                    else if (p.F1[i][j] || X_V(i, j).get(GRB_DoubleAttr_X) > 0.5)
-                        heuristicSolution[i] = j;
+            {
+                p.F->for_free(i, [&](int j) { if (X_V(i, j).get(GRB_DoubleAttr_X) > 0.5) heuristicSolution[i] = j; });
+                p.F->for_one(i, [&](int j) { heuristicSolution[i] = j; });
+            }
         }
     }
     catch (GRBException e) {
@@ -343,199 +358,610 @@ void ContiguityHeuristic(vector<int> &heuristicSolution, graph* g, const vector<
         obj += w[i][heuristicSolution[i]];
     cout << "UB of (contiguous) heuristicSolution = " << obj << endl;
     if (cb)
+    {
+        // the model still has cb installed with lazy constraints on; it is rebuilt on the next use anyway
+        s.release_model();
         delete cb;
+    }
     return;
 }
 
-vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, double &UB, int maxIterations, bool do_cuts)
+GRBEnv& restricted_session::environment()
 {
-  vector<int> heuristicSolution(g->nr_nodes, -1);
+  if (!env)
+    env.reset(new GRBEnv());
+  return *env;
+}
 
-  vector<int> centers(k, -1);
-  for (int i = 0; i < k; ++i) centers[i] = i; // dummy initialization just for build hess restricted. 
-  vector<int> iterHeuristicSolution(g->nr_nodes, -1);
+GRBModel& restricted_session::restrict_to(const vector<int>& centers)
+{
+  if (!model || extended || columns.size() != centers.size())
+  {
+    model.reset(); // before the new model is built
+    model.reset(new GRBModel(environment()));
+    p = build_hess_restricted(model.get(), g, w, population, centers, L, U, k);
+    columns = centers;
+    extended = false;
+    for (int j : centers)
+      X_V(j, j).set(GRB_DoubleAttr_LB, 1); // assign the centers to themselves
+    return *model;
+  }
 
-  HessCallback* cb = nullptr;
+  // centers still present keep their column, the new ones take the columns that were freed
+  vector<char> kept(g->nr_nodes, 0), placed(g->nr_nodes, 0);
+  for (int j : centers)
+    kept[j] = 1;
+  vector<int> next(columns.size(), -1), changed;
+  for (size_t t = 0; t < columns.size(); ++t)
+    if (kept[columns[t]])
+    {
+      next[t] = columns[t];
+      placed[columns[t]] = 1;
+    }
+  size_t t = 0;
+  for (int j : centers)
+    if (!placed[j])
+    {
+      while (next[t] >= 0)
+        ++t;
+      next[t] = j;
+      changed.push_back(t);
+      X_V(columns[t], columns[t]).set(GRB_DoubleAttr_LB, 0); // the old center of column t
+    }
+  if (changed.empty())
+    return *model;
 
-  try {
+  populate_hess_params(p, g, next);
+  columns = next;
+  for (int t : changed)
+  {
+    set_column_obj(model.get(), p, columns[t], w, columns[t]);
+    X_V(columns[t], columns[t]).set(GRB_DoubleAttr_LB, 1);
+  }
+  return *model;
+}
 
-    GRBEnv env = GRBEnv();
-    GRBModel model = GRBModel(env);
+double restricted_session::polish(const vector<int>& centers, vector<int>& solution, double obj, bool do_cuts)
+{
+  HessCallback* cb = nullptr;
+  try {
+    GRBModel& model = restrict_to(centers);
     model.set(GRB_DoubleParam_TimeLimit, 60.);
     model.set(GRB_IntParam_OutputFlag, 0);
+    model.set(GRB_DoubleParam_MIPGap, 0.0005);
+
+    if (do_cuts)
+      cb = build_cut(&model, p, g, population);
+    vector<double> start(p.h.size(), 0.);
+    for (int i = 0; i < g->nr_nodes; ++i)
+      if (solution[i] >= 0 && IS_X(i, solution[i]))
+        start[X_I(i, solution[i])] = 1.;
+    model.set(GRB_DoubleAttr_Start, p.x, start.data(), static_cast<int>(start.size()));
+    model.optimize();
+
+    if ((model.get(GRB_IntAttr_Status) == 2 || model.get(GRB_IntAttr_Status) == 9) && model.get(GRB_IntAttr_SolCount) > 0
+        && model.get(GRB_DoubleAttr_ObjVal) < obj)
+    {
+      obj = model.get(GRB_DoubleAttr_ObjVal);
+      int nr_var = static_cast<int>(p.h.size());
+      double* x = model.get(GRB_DoubleAttr_X, p.x, nr_var);
+      for (int v = 0; v < nr_var; ++v)
+        if (x[v] > 0.5)
+          solution[p.h.row(v)] = p.h.column(v);
+      delete[] x;
+    }
+    if (cb)
+    {
+      model.setCallback(nullptr);
+      model.set(GRB_IntParam_LazyConstraints, 0);
+      model.set(GRB_IntParam_PreCrush, 0);
+    }
+  }
+  catch (GRBException e) {
+    cout << "Error code = " << e.getErrorCode() << endl;
+    cout << e.getMessage() << endl;
+    extended = true;
+  }
+  catch (...) {
+    cout << "Exception during optimization" << endl;
+    extended = true;
+  }
+  if (cb)
+  {
+    if (extended)
+      model.reset(); // may still point to cb
+    delete cb;
+  }
+  return obj;
+}
 
-    hess_params p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
+// after this many rounds a descent stops once it is HessCutoffRatio above the incumbent of the earlier batches
+const int HessCutoffRounds = 2;
+const double HessCutoffRatio = 1.1;
+// seed of the RNG stream of restart r is HessSeed + r, seeds are reproducible for any thread count
+const unsigned int HessSeed = 20200101;
 
-    vector<int> allNodes(g->nr_nodes, -1);
-    for (int i = 0; i < g->nr_nodes; ++i) allNodes[i] = i;
+// uniform in [0, 1) from the raw mt19937 output, which unlike std distributions is the same everywhere
+static double uniform01(mt19937& rng)
+{
+  return rng() / 4294967296.;
+}
 
-    for (int iter = 0; iter < maxIterations; ++iter)
+// index drawn with probability weight[i] / sum, the last positive one if rounding runs past the end
+static int sample(const vector<double>& weight, mt19937& rng)
+{
+  double total = 0.;
+  for (double v : weight)
+    total += v;
+  double u = uniform01(rng) * total;
+  int last = -1;
+  for (int i = 0; i < static_cast<int>(weight.size()); ++i)
+    if (weight[i] > 0.)
     {
-      // select k centers at random
-      random_shuffle(allNodes.begin(), allNodes.end()); //FIXME O(n) instead of O(k)
-      for (int i = 0; i < k; ++i)
-        centers[i] = allNodes[i];
+      last = i;
+      if (u < weight[i])
+        return i;
+      u -= weight[i];
+    }
+  return last;
+}
 
-      double iterUB = MYINFINITY; // the best UB found in this iteration (iter)
-      double oldIterUB;     // the UB found in the previous iteration
-      for (int i = 0; i < g->nr_nodes; ++i) // reset vector for this iteration's heuristic solution 
-        iterHeuristicSolution[i] = -1;
+// population-weighted k-means++: the first center drawn by population, every next one with
+// probability proportional to its cost min_c w[i][c] to the centers so far; min(k, n) distinct centers
+static vector<int> seed_kmeanspp(const vector<vector<double> >& w, const vector<int>& population, int k, mt19937& rng)
+{
+  int n = population.size();
+  k = min(k, n);
+  vector<double> weight(population.begin(), population.end());
+  vector<double> cost(n, MYINFINITY);
+  vector<char> chosen(n, 0);
+  vector<int> centers;
+  for (int c = 0; c < k; ++c)
+  {
+    int j = sample(weight, rng);
+    if (j < 0) // every node left costs 0 (or has no population), take the first one not chosen yet
+      for (j = 0; j < n && chosen[j]; ++j);
+    chosen[j] = 1;
+    centers.push_back(j);
+    for (int i = 0; i < n; ++i)
+    {
+      cost[i] = min(cost[i], i == j ? 0. : w[i][j]);
+      weight[i] = chosen[i] ? 0. : cost[i];
+    }
+  }
+  return centers;
+}
 
-      model.set(GRB_DoubleParam_MIPGap, 0.1); // Allow a loose gap in the first iteration. (The centers will be awful at first.)
-      bool centersChange;
+// greedy farthest point under population caps: after [first], the next center is the node of
+// highest cost min_c w[i][c] among the districts of nearest-center assignment holding more than U,
+// or among all nodes once none does; min(k, n) distinct centers
+static vector<int> seed_farthest(const vector<vector<double> >& w, const vector<int>& population, int U, int k, int first)
+{
+  int n = population.size();
+  k = min(k, n);
+  vector<double> cost(n, MYINFINITY);
+  vector<int> nearest(n, -1);
+  vector<long long> load;
+  vector<int> centers;
+  int j = first;
+  for (int c = 0; c < k; ++c)
+  {
+    centers.push_back(j);
+    load.assign(c + 1, 0);
+    for (int i = 0; i < n; ++i)
+    {
+      double d = i == j ? 0. : w[i][j];
+      if (d < cost[i] || nearest[i] < 0)
+      {
+        cost[i] = d;
+        nearest[i] = c;
+      }
+    }
+    for (int i = 0; i < n; ++i)
+      load[nearest[i]] += population[i];
+    bool over = false;
+    for (long long l : load)
+      over = over || l > U;
+    j = -1;
+    for (int i = 0; i < n; ++i)
+      if ((!over || load[nearest[i]] > U) && cost[i] > 0. && (j < 0 || cost[i] > cost[j]))
+        j = i;
+    if (j < 0 && c + 1 < k) // no node left away from the centers, take the first one not chosen yet
+      for (j = 0; j < n && find(centers.begin(), centers.end(), j) != centers.end(); ++j);
+  }
+  return centers;
+}
 
-      // perform Hess descent
-      do {
-        oldIterUB = iterUB;
-        centersChange = false;
+// starting centers of restart r: the farthest point seeding from the population-weighted medoid first,
+// then k-means++ and farthest point from a drawn node in turn, all from the restart's own stream
+static vector<int> seed_centers(const vector<vector<double> >& w, const vector<int>& population, int U, int k, unsigned int r)
+{
+  int n = population.size();
+  mt19937 rng(HessSeed + r);
+  if (r % 2 == 1)
+    return seed_kmeanspp(w, population, k, rng);
+  int first = 0;
+  if (r == 0)
+  {
+    double best = MYINFINITY;
+    for (int j = 0; j < n; ++j)
+    {
+      double total = 0.;
+      for (int i = 0; i < n; ++i)
+        total += w[i][j];
+      if (total < best)
+      {
+        best = total;
+        first = j;
+      }
+    }
+  }
+  else
+    first = static_cast<int>(uniform01(rng) * n);
+  return seed_farthest(w, population, U, k, first);
+}
 
-        // Reset objective (Gurobi assumes minimization objective.)
-        populate_hess_params(p, g, centers); // now just use X(i,j), F0, F1 and more importantly hashtable are properly set up
-        if (do_cuts)
-        {
-          if (cb)
-            delete cb;
-          build_cut(&model, p, g, population); //FIXME do pointers instead? worth it? prob no
-        }
-        model.reset(); // should be done in any case for predicted behavior
-        for (int i = 0; i < g->nr_nodes; ++i)
-          for (int j : centers)
-          {
-            ENSURE(i, j);
-            X_V(i, j).set(GRB_DoubleAttr_Obj, w[i][j]);
-          }
-
-        GRBLinExpr numCenters = 0;
-        for (int j : centers)
-        {
-          ENSURE(j, j);
-          numCenters += X(j, j); // different map for different centers!
-        }
+// district_medoid looks at this many unseen members nearest to the best center per round, and adds member costs
+// this many at a time between checks against the best cost
+const int MedoidNeighbors = 16;
+const int MedoidChunk = 32;
+
+// the member c of a district minimizing sum_v w[v][c], searched outwards from the current center: each round evaluates
+// the MedoidNeighbors unseen members nearest to the best center so far and stops once it keeps its place. w >= 0, so a
+// partial sum that reaches the best cost rules a candidate out for good. Ties keep the current center; seen is all 0
+// on entry and on return. w[i][j] is a distance scaled by population[i], so nearness is w[c][b] / population[c], or
+// w[b][c] / population[b] for an empty c; a round from an empty center b can't rank the empty members and looks at
+// every unseen member
+static int district_medoid(const vector<vector<double> >& w, const vector<int>& population, const vector<int>& members,
+  int center, vector<char>& seen, vector<int>& candidates)
+{
+  double best = 0;
+  for (int v : members)
+    best += w[v][center];
+  int bestCenter = center;
+  seen[center] = 1;
+
+  int m = members.size();
+  for (int previous = -1; previous != bestCenter; )
+  {
+    previous = bestCenter;
+    int b = bestCenter;
+    auto distance = [&](int c) {
+      if (population[c] > 0)
+        return w[c][b] / population[c];
+      return population[b] > 0 ? w[b][c] / population[b] : MYINFINITY;
+    };
+    auto closer = [&](int c, int d) {
+      double dc = distance(c), dd = distance(d);
+      return dc < dd || (dc == dd && c < d);
+    };
+    candidates.clear();
+    for (int c : members)
+      if (!seen[c])
+        candidates.push_back(c);
+    if (candidates.size() > MedoidNeighbors && population[b] > 0)
+    {
+      nth_element(candidates.begin(), candidates.begin() + MedoidNeighbors, candidates.end(), closer);
+      candidates.resize(MedoidNeighbors);
+    }
+    sort(candidates.begin(), candidates.end(), closer);
 
-        model.addConstr(numCenters == k, "fixCenters");  // in essence, fix the current centers to 1
-        model.optimize();
+    for (int c : candidates)
+    {
+      seen[c] = 1;
+      double cost = 0;
+      int p = 0;
+      for (; p < m; p += MedoidChunk)
+      {
+        int end = min(p + MedoidChunk, m);
+        for (int q = p; q < end; ++q)
+          cost += w[members[q]][c];
+        if (cost >= best)
+          break;
+      }
+      if (p >= m)
+      {
+        best = cost;
+        bestCenter = c;
+      }
+    }
+  }
+  for (int c : members)
+    seen[c] = 0;
+  return bestCenter;
+}
 
-        if (model.get(GRB_IntAttr_Status) == 2 || model.get(GRB_IntAttr_Status) == 9) // model was solved to optimality (subject to tolerances), so update UB.
-        {
-          iterUB = model.get(GRB_DoubleAttr_ObjVal); // we get a warm start from previous round, so iterUB will only get better
-          cout << "  UB from restricted IP = " << iterUB << " using centers : ";
-          for (int i = 0; i < k; ++i)
-            cout << centers[i] << " ";
-          cout << endl;
-        }
+// improvements below this are treated as ties by move_search
+const double MoveSearchEps = 1e-9;
 
-        model.remove(model.getConstrByName("fixCenters")); // unfix the current centers
+// native descent over assignments: a node moves to a district one of its neighbors is in, or two neighbors in
+// different districts trade places, whenever the objective drops and both districts stay in [L, U]. District
+// populations and costs are kept, so a move or swap is judged in O(1); once neither improves, districts that
+// changed get their medoid as center and the descent goes on until nothing changes
+class move_search
+{
+private:
+  graph* g;
+  const vector<vector<double> >& w;
+  const vector<int>& population;
+  int L, U;
+  vector<int> where; // node -> district
+  vector<long long> load;
+  vector<double> cost;
+  vector<char> touched; // district changed since it was last centered
+  vector<vector<int> > members;
+  vector<char> seen;
+  vector<int> candidates;
+  bool fits(int d, long long change) const { return load[d] + change >= L && load[d] + change <= U; }
+  void shift(int i, int a, int b, const vector<int>& centers)
+  {
+    load[a] -= population[i]; load[b] += population[i];
+    cost[a] -= w[i][centers[a]]; cost[b] += w[i][centers[b]];
+    where[i] = b;
+    touched[a] = touched[b] = 1;
+  }
+  bool improve_moves(const vector<int>& centers);
+  bool improve_swaps(const vector<int>& centers);
+  bool recenter(vector<int>& centers);
+public:
+  move_search(graph* g_, const vector<vector<double> >& w_, const vector<int>& population_, int L_, int U_)
+    : g(g_), w(w_), population(population_), L(L_), U(U_), where(g_->nr_nodes), seen(g_->nr_nodes, 0) {}
+  // descend from a feasible [assignment] to [centers], both updated in place, @return the objective
+  double descend(vector<int>& centers, vector<int>& assignment);
+};
+
+bool move_search::improve_moves(const vector<int>& centers)
+{
+  bool improved = false;
+  for (int i = 0; i < g->nr_nodes; ++i)
+  {
+    int a = where[i];
+    if (centers[a] == i || !fits(a, -population[i]))
+      continue;
+    int best = -1;
+    double best_delta = -MoveSearchEps;
+    for (int u : g->nb(i))
+    {
+      int b = where[u];
+      double delta = w[i][centers[b]] - w[i][centers[a]];
+      if (b != a && delta < best_delta && fits(b, population[i]))
+      {
+        best = b;
+        best_delta = delta;
+      }
+    }
+    if (best >= 0)
+    {
+      shift(i, a, best, centers);
+      improved = true;
+    }
+  }
+  return improved;
+}
 
-        if (iterUB < oldIterUB) // objective value strictly improved, so we need to update incumbent for this iteration
-        {
-          for (int j_i = 0; j_i < k; ++j_i)  // find all nodes assigned to the j-th center.
-          {
-            vector<int> district;
-            for (int i = 0; i < g->nr_nodes; ++i)
-            {
-              ENSURE(i, centers[j_i]);
-              if (X_V(i, centers[j_i]).get(GRB_DoubleAttr_X) > 0.5) //FIXME cerr if not IS_X
-              {
-                district.push_back(i);
-                iterHeuristicSolution[i] = centers[j_i]; // update this iteration's incumbent
-              }
-            }
+bool move_search::improve_swaps(const vector<int>& centers)
+{
+  bool improved = false;
+  for (int i = 0; i < g->nr_nodes; ++i)
+  {
+    int a = where[i];
+    if (centers[a] == i)
+      continue;
+    for (int u : g->nb(i))
+    {
+      int b = where[u];
+      if (b == a || centers[b] == u)
+        continue;
+      long long change = population[u] - population[i]; // of district a
+      double delta = w[i][centers[b]] - w[i][centers[a]] + w[u][centers[a]] - w[u][centers[b]];
+      if (delta < -MoveSearchEps && fits(a, change) && fits(b, -change))
+      {
+        shift(i, a, b, centers);
+        shift(u, b, a, centers);
+        improved = true;
+        break;
+      }
+    }
+  }
+  return improved;
+}
 
-            // find best center of this district
-            int bestCenter = -1;
-            double bestCost = MYINFINITY;
+bool move_search::recenter(vector<int>& centers)
+{
+  int k = centers.size();
+  for (int j = 0; j < k; ++j)
+    members[j].clear();
+  for (int i = 0; i < g->nr_nodes; ++i)
+    if (touched[where[i]])
+      members[where[i]].push_back(i);
+  bool changed = false;
+  for (int j = 0; j < k; ++j)
+  {
+    if (!touched[j])
+      continue;
+    touched[j] = 0;
+    int c = district_medoid(w, population, members[j], centers[j], seen, candidates);
+    if (c == centers[j])
+      continue;
+    centers[j] = c;
+    cost[j] = 0;
+    for (int v : members[j])
+      cost[j] += w[v][c];
+    changed = true;
+  }
+  return changed;
+}
 
-            for (int i = 0; i < district.size(); ++i)
-            {
-              // compute the Cost of this district when centered at c
-              int c = district[i];
-              double Cost = 0;
-
-              for (int p = 0; p < district.size(); ++p)
-              {
-                int v = district[p];
-                Cost += w[v][c];
-              }
-
-              if (Cost < bestCost)
-              {
-                bestCenter = c;
-                bestCost = Cost;
-              }
-            }
+double move_search::descend(vector<int>& centers, vector<int>& assignment)
+{
+  int k = centers.size();
+  load.assign(k, 0);
+  cost.assign(k, 0.);
+  touched.assign(k, 1);
+  members.resize(k);
+  vector<int> district(g->nr_nodes, -1);
+  for (int j = 0; j < k; ++j)
+    district[centers[j]] = j;
+  for (int i = 0; i < g->nr_nodes; ++i)
+  {
+    where[i] = district[assignment[i]];
+    load[where[i]] += population[i];
+    cost[where[i]] += w[i][assignment[i]];
+  }
 
-            if (centers[j_i] != bestCenter) // if the centers haven't changed, there's no reason to resolve the IP
-            {
-              centersChange = true;
-              centers[j_i] = bestCenter; // update the best center for this district
-            }
-          }
-        }
-        // Now that the centers should be reasonable, require a tighter tolerance
-        model.set(GRB_DoubleParam_MIPGap, 0.0005);
+  while (true)
+  {
+    bool improved = improve_moves(centers);
+    if (!improved)
+      improved = improve_swaps(centers);
+    if (!improved && !recenter(centers))
+      break;
+  }
 
-      } while (iterUB < oldIterUB && centersChange);
+  double obj = 0;
+  for (int i = 0; i < g->nr_nodes; ++i)
+  {
+    assignment[i] = centers[where[i]];
+    obj += w[i][assignment[i]];
+  }
+  return obj;
+}
 
-      // update incumbents (if needed)
-      if (iterUB < UB)
+// Hess descent from [centers]: assign, move every center to the medoid of its district, repeat while
+// the objective improves; stops early above cutoff() * HessCutoffRatio. @return the best objective,
+// with its centers and assignment in [centers] and [solution]
+static double hess_descent(graph* g, const vector<vector<double> >& w, const vector<int>& population, assignment_solver& solver, vector<int>& centers,
+  vector<int>& solution, const function<double ()>& cutoff)
+{
+  int k = centers.size();
+  vector<int> assignment;
+  vector<int> current(centers);
+  vector<vector<int> > districts(k);
+  vector<int> position(g->nr_nodes, -1), candidates;
+  vector<char> seen(g->nr_nodes, 0);
+  double best = MYINFINITY;
+  for (int round = 0; ; ++round)
+  {
+    double obj = solver.solve(current, assignment);
+    if (obj >= best)
+      break;
+    best = obj;
+    solution = assignment;
+    centers = current;
+    if (round + 1 >= HessCutoffRounds && best > cutoff() * HessCutoffRatio)
+      break;
+
+    bool centersChange = false;
+    for (int j_i = 0; j_i < k; ++j_i)
+    {
+      position[current[j_i]] = j_i;
+      districts[j_i].clear();
+    }
+    for (int i = 0; i < g->nr_nodes; ++i)
+      districts[position[assignment[i]]].push_back(i);
+    for (int j_i = 0; j_i < k; ++j_i)
+    {
+      int bestCenter = district_medoid(w, population, districts[j_i], current[j_i], seen, candidates);
+      if (current[j_i] != bestCenter) // if the centers haven't changed, there's no reason to resolve
       {
-        UB = iterUB;
-        heuristicSolution = iterHeuristicSolution;
+        centersChange = true;
+        current[j_i] = bestCenter; // update the best center for this district
       }
-      cout << "In iteration " << iter << " of HessHeuristic, objective value of incumbent is = " << UB << endl;
     }
+    if (!centersChange)
+      break;
   }
-  catch (GRBException e) {
-    cout << "Error code = " << e.getErrorCode() << endl;
-    cout << e.getMessage() << endl;
-  }
-  catch (const char* msg) {
-    cout << "Exception with message : " << msg << endl;
+  return best;
+}
+
+vector<int> HessHeuristic(graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k, double &UB,
+  int maxIterations, bool do_cuts, unsigned int nr_threads, unsigned int batch, restricted_session* session,
+  const vector<vector<int> >* seeds)
+{
+  vector<int> heuristicSolution(g->nr_nodes, -1);
+
+  // restart 0 runs alone and gives the incumbent, the others run in batches of [batch] concurrent restarts,
+  // each thread with its own native solver, cut off against the incumbent of the earlier batches; results are
+  // kept per restart and the best one is picked in restart order, so they depend on the batch size only
+  thread_pool pool(nr_threads > 0 ? nr_threads - 1 : 0);
+  if (batch == 0)
+    batch = pool.size();
+  vector<assignment_solver> solvers(pool.size(), assignment_solver(w, population, L, U));
+  vector<double> restartUB(maxIterations, MYINFINITY);
+  vector<vector<int>> restartCenters(maxIterations), restartSolution(maxIterations);
+  double incumbent = UB;
+  auto cutoff = [&incumbent]() { return incumbent; };
+
+  for (int first = 0; first < maxIterations; )
+  {
+    int size = first == 0 ? 1 : min(static_cast<int>(batch), maxIterations - first);
+    pool.run(size, [&](unsigned int b, unsigned int tid) {
+      unsigned int iter = first + b;
+      vector<int> centers = seeds && iter < seeds->size() ? (*seeds)[iter] : seed_centers(w, population, U, k, iter);
+
+      double obj = hess_descent(g, w, population, solvers[tid], centers, restartSolution[iter], cutoff);
+      restartUB[iter] = obj;
+      restartCenters[iter] = centers;
+      printf("Restart %u of HessHeuristic: objective %.2lf\n", iter, obj);
+    });
+    for (int iter = first; iter < first + size; ++iter)
+      incumbent = min(incumbent, restartUB[iter]);
+    first += size;
   }
-  catch (...) {
-    cout << "Exception during optimization" << endl;
+
+  vector<int> bestCenters;
+  for (int iter = 0; iter < maxIterations; ++iter)
+    if (restartUB[iter] < UB)
+    {
+      UB = restartUB[iter];
+      heuristicSolution = restartSolution[iter];
+      bestCenters = restartCenters[iter];
+    }
+  cout << "After " << maxIterations << " restarts of HessHeuristic, objective value of incumbent is = " << UB << endl;
+
+  // exact assignment for the best centers
+  if (!bestCenters.empty())
+  {
+    restricted_session own(g, w, population, L, U, k);
+    UB = (session ? *session : own).polish(bestCenters, heuristicSolution, UB, do_cuts);
+    cout << "UB from restricted IP on the best centers = " << UB << endl;
   }
 
   cout << "UB at end of HessHeuristic = " << UB << endl;
   double obj = 0;
   for (int i = 0; i < g->nr_nodes; ++i)
-    obj += w[i][heuristicSolution[i]];
+    obj += heuristicSolution[i] >= 0 ? w[i][heuristicSolution[i]] : MYINFINITY;
   cout << "UB of heuristicSolution = " << obj << endl;
-  if (cb)
-    delete cb;
   return heuristicSolution;
 }
 
+// Zobrist keys of the nodes; a set of centers hashes to the xor of its keys
+static vector<unsigned long long> zobrist_keys(int n)
+{
+  mt19937_64 rng(HessSeed);
+  vector<unsigned long long> keys(n);
+  for (int i = 0; i < n; ++i)
+    keys[i] = rng();
+  return keys;
+}
+
 bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>& population,
-  int L, int U, int k, vector<int>&heuristicSolution, double &UB)
+  int L, int U, int k, vector<int>&heuristicSolution, double &UB, unsigned int nr_threads, restricted_session* session)
 {
     cout << endl << "Beginning LOCAL SEARCH with UB = " << UB << "\n\n";
 
-    if(heuristicSolution.size() < g->nr_nodes)
+    if(heuristicSolution.size() < g->nr_nodes || find(heuristicSolution.begin(), heuristicSolution.end(), -1) != heuristicSolution.end())
     {
       printf("Local search received no solution from Heuristic, bailing out...\n");
       return false;
     }
 
-    // hash routines
-    unordered_set<string> htbl;
-    auto centers_to_string = [](const vector<int>& centers) -> string {
-      vector<int> sorted_centers(centers);
-      sort(sorted_centers.begin(), sorted_centers.end());
-      string ret;
-      for(int c : sorted_centers)
-      {
-        ret += to_string(c) + "_";
-      }
-      return ret;
-    };
-
     // initialize the centers from heuristicSolution
     vector<int> centers(k, -1);
     int pos = 0;
     for (int i = 0; i < g->nr_nodes; ++i)
     {
-      if (heuristicSolution[i] == i)
+      if (heuristicSolution[i] == i && pos < k)
       {
         centers[pos] = i;
         pos++;
@@ -548,101 +974,70 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
       return false;
     }
 
-    try {
-      GRBEnv env = GRBEnv();
-      GRBModel model = GRBModel(env);
-      hess_params p = build_hess_restricted(&model, g, w, population, centers, L, U, k);
-      for (int j : centers)
-      {
-        ENSURE(j, j);
-        X_V(j, j).set(GRB_DoubleAttr_LB, 1); // assign the centers to themselves.
-      }
-      model.set(GRB_DoubleParam_TimeLimit, 60.);
-      model.set(GRB_IntParam_OutputFlag, 0);
-      bool improvement;
-      do {
-        improvement = false;
-        for (int c_i = 0; c_i < k && !improvement; ++c_i)
-        {
-          int v = centers[c_i];
-          cout << "  checking neighbors of node " << v << endl;
-          for (int u : g->nb(v))  // swap v for u?
-          {
-            if (improvement) break;
-            // cache centers
-            centers[c_i] = u;
-            string centers_str = centers_to_string(centers);
-            centers[c_i] = v;
-            if(htbl.count(centers_str) > 0)
-            {
-              printf("Local Search skipping seen centers...\n");
-              continue;
-            }
-            htbl.insert(centers_str);
-            model.reset();
-            model.set(GRB_DoubleParam_Cutoff, UB);
-            // update cost coefficients, as if we had centers[p] = u
-            for (int i = 0; i < g->nr_nodes; ++i)
-            {
-              ENSURE(i,v);
-              X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][u]);
-            }
-            X_V(v,v).set(GRB_DoubleAttr_LB, 0);
-            X_V(u,v).set(GRB_DoubleAttr_LB, 1);
-            model.optimize();
-            // revert back
-            for (int i = 0; i < g->nr_nodes; ++i)
-              X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][v]);
-            X_V(v,v).set(GRB_DoubleAttr_LB, 1);
-            X_V(u,v).set(GRB_DoubleAttr_LB, 0);
-            // update incumbent (if needed) if solved or timed out
-            if (model.get(GRB_IntAttr_Status) == 2 || model.get(GRB_IntAttr_Status) == 9) // model was solved to optimality (subject to tolerances), so update UB.
-            {
-              double newUB = model.get(GRB_DoubleAttr_ObjVal);
-              if (newUB < UB)
-              {
-                improvement = true;
-                cout << "found better UB from LS restricted IP = " << newUB;
-                UB = newUB;
-                // update centers, costs, and var fixings
-                centers[c_i] = u;
-                for (int i = 0; i < g->nr_nodes; ++i)
-                  X_V(i,v).set(GRB_DoubleAttr_Obj, w[i][u]);
-                X_V(v,v).set(GRB_DoubleAttr_LB, 0);
-                X_V(u,v).set(GRB_DoubleAttr_LB, 1);
-                cout << " with centers : ";
-                for (int i = 0; i < k; ++i)
-                  cout << centers[i] << " ";
-                cout << endl;
-                // update hess params
-                populate_hess_params(p, g, centers);
-                // update heuristicSolution
-                for (int i = 0; i < g->nr_nodes; ++i)
-                  for (int j = 0; j < k; ++j)
-                  {
-                    ENSURE(i,centers[j]);
-                    if (X_V(i,centers[j]).get(GRB_DoubleAttr_X) > 0.5)
-                      heuristicSolution[i] = centers[j];
-                  }
-              }
-            }
-          }
-        }
-      } while (improvement);
-    }
-    catch (GRBException e) {
-      cout << "Error code = " << e.getErrorCode() << endl;
-      cout << e.getMessage() << endl;
-      return false;
-    }
-    catch (const char* msg) {
-      cout << "Exception with message : " << msg << endl;
-      return false;
-    }
-    catch (...) {
-      cout << "Exception during optimization" << endl;
-      return false;
+    // center sets already evaluated, by Zobrist hash
+    vector<unsigned long long> keys = zobrist_keys(g->nr_nodes);
+    unordered_set<unsigned long long> htbl;
+    auto hash_centers = [&keys](const vector<int>& centers) {
+      unsigned long long h = 0;
+      for (int c : centers)
+        h ^= keys[c];
+      return h;
+    };
+
+    // all unseen center swaps are evaluated concurrently by per-thread native assignment solvers and the best one
+    // is taken, ties to the first in (center, neighbor) order, so the result does not depend on nr_threads. It is
+    // driven to convergence by node moves; only the final solution goes to the restricted IP
+    thread_pool pool(nr_threads > 0 ? nr_threads - 1 : 0);
+    vector<assignment_solver> solvers(pool.size(), assignment_solver(w, population, L, U));
+    vector<vector<int> > trialCenters(pool.size()), trialAssignment(pool.size());
+    move_search moves(g, w, population, L, U);
+    UB = moves.descend(centers, heuristicSolution);
+    htbl.insert(hash_centers(centers));
+    cout << "UB after node moves = " << UB << endl;
+
+    vector<char> is_center(g->nr_nodes, 0);
+    vector<pair<int, int> > trials; // (position in centers, new center)
+    vector<double> trialUB;
+    while (true)
+    {
+      unsigned long long h = hash_centers(centers);
+      for (int c : centers)
+        is_center[c] = 1;
+      trials.clear();
+      for (int c_i = 0; c_i < k; ++c_i)
+        for (int u : g->nb(centers[c_i]))  // swap centers[c_i] for u?
+          if (!is_center[u] && htbl.insert(h ^ keys[centers[c_i]] ^ keys[u]).second)
+            trials.push_back(make_pair(c_i, u));
+      for (int c : centers)
+        is_center[c] = 0;
+      if (trials.empty())
+        break;
+
+      trialUB.assign(trials.size(), MYINFINITY);
+      pool.run(trials.size(), [&](unsigned int t, unsigned int tid) {
+        trialCenters[tid] = centers;
+        trialCenters[tid][trials[t].first] = trials[t].second;
+        trialUB[t] = solvers[tid].solve(trialCenters[tid], trialAssignment[tid]);
+      });
+      int best = min_element(trialUB.begin(), trialUB.end()) - trialUB.begin();
+      printf("Local search evaluated %d swaps, best objective %.2lf\n", static_cast<int>(trials.size()), trialUB[best]);
+      if (trialUB[best] >= UB)
+        break;
+
+      centers[trials[best].first] = trials[best].second;
+      vector<int> assignment;
+      solvers[0].solve(centers, assignment);
+      UB = moves.descend(centers, assignment);
+      htbl.insert(hash_centers(centers));
+      heuristicSolution = assignment;
+      cout << "found better UB from LS restricted assignment = " << UB << " with centers : ";
+      for (int i = 0; i < k; ++i)
+        cout << centers[i] << " ";
+      cout << endl;
     }
+
+    restricted_session own(g, w, population, L, U, k);
+    UB = (session ? *session : own).polish(centers, heuristicSolution, UB, false);
     cout << "UB at end of local search heuristic = " << UB << endl;
     double obj = 0;
     for (int i = 0; i < g->nr_nodes; ++i)
@@ -650,73 +1045,3 @@ bool LocalSearch(graph* g, const vector<vector<double> >& w, const vector<int>&
     cout << "UB of heuristicSolution = " << obj << endl;
     return true;
 }
-
-hess_params build_hess_special(GRBModel* model, graph* g, const vector<vector<double> >& w, const vector<int>& population, int L, int U, int k)
-{
-  // create GUROBI Hess model
-  int n = g->nr_nodes;
-  hess_params p;
-  p.n = n;
-  p.F0 = std::vector<std::vector<bool>>(n, std::vector<bool>(n, false));
-  p.F1 = std::vector<std::vector<bool>>(n, std::vector<bool>(n, false));
-
-  // do this only for compatibility with typical hess
-  int cur = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-        p.h[n*i + j] = cur++; //FIXME unify ind
-
-  printf("Build hess : created %lu variables\n", p.h.size());
-  int nr_var = static_cast<int>(p.h.size());
-
-  // create variables
-  p.x = model->addVars(nr_var, GRB_CONTINUOUS); // !! create relaxation
-  model->update();
-  // Set objective: minimize sum d^2_ij*x_ij
-  GRBLinExpr expr = 0;
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-      expr += w[i][j] * X(i, j);
-
-  model->setObjective(expr, GRB_MINIMIZE);
-
-  // add constraints (b)
-  for (int i = 0; i < n; ++i)
-  {
-    GRBLinExpr constr = 0;
-    for (int j = 0; j < n; ++j)
-      constr += X(i, j);
-    model->addConstr(constr == 1);
-  }
-
-  // add constraint (d)
-  for (int l = 0; l < 2; ++l) // firstly add lower bound
-  for (int j = 0; j < n; ++j)
-  {
-    GRBLinExpr constr = 0;
-    for (int i = 0; i < n; ++i)
-      constr += population[i] * X(i, j);
-    if(l == 0)
-      model->addConstr(constr - L * X(j, j) >= 0);
-    else
-      model->addConstr(constr - U * X(j, j) <= 0);
-  }
-
-
-  // add constraint (c)
-  expr = 0;
-  for (int j = 0; j < n; ++j)
-    expr += X(j, j);
-  model->addConstr(expr == k);
-
-  // add contraints (e)
-  for (int i = 0; i < n; ++i)
-    for (int j = 0; j < n; ++j)
-        model->addConstr(X(i, j) <= X(j, j));
-
-  model->update();
-
-  //model->write("debug_hess_special.lp");
-
-  return p;
-}
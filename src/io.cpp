@@ -11,6 +11,7 @@
 
 #include "districting/graph.hpp"
 #include "districting/common.hpp"
+#include "districting/parallel.hpp"
 
 using namespace std;
 
@@ -77,15 +78,16 @@ void translate_solution(hess_params& p, vector<int>& sol, int n)
     // firstly assign district number for clusterheads
     for(int i = 0; i < n; ++i)
     {
-      if(p.F0[i][i])
+      if(p.F->is_zero(i, i))
         continue;
-      if(p.F1[i][i] || X_V(i,i).get(GRB_DoubleAttr_X) > 0.5)
+      if(p.F->is_one(i, i) || X_V(i,i).get(GRB_DoubleAttr_X) > 0.5)
         heads[i] = cur++;
     }
     for(int i = 0; i < n; ++i)
-      for(int j = 0; j < n; ++j)
-        if(p.F0[i][j]) continue; else if (p.F1[i][j] || X_V(i,j).get(GRB_DoubleAttr_X) > 0.5)
-          sol[i] = heads[j];
+    {
+      p.F->for_free(i, [&](int j) { if (X_V(i,j).get(GRB_DoubleAttr_X) > 0.5) sol[i] = heads[j]; });
+      p.F->for_one(i, [&](int j) { sol[i] = heads[j]; });
+    }
 }
 
 // prints the solution <node> <district>
@@ -207,6 +209,16 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   if(ralg_hot_start && strlen(ralg_hot_start) > 1)
     rp.ralg_hot_start = ralg_hot_start;
   rp.output = stderr;
+  rp.lagrange_threads = 1;
+  rp.cut_threads = 1;
+  rp.fixing_threads = 1;
+  rp.heuristic_threads = 1;
+  rp.heuristic_restarts = 10; // 10 iterations is often sufficient
+  rp.heuristic_batch = 0; // heuristic_threads
+  rp.checkpoint_interval = 600;
+  rp.resume = false;
+  rp.lagrange_shrink = false;
+  rp.lagrange_coarsen = 0;
 
   char buf[1020];
   string database;
@@ -292,6 +304,53 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
       else
         rp.k = atoi(v);
     }
+    else if((v = parse_param(buf, "checkpoint")) != nullptr)
+      rp.checkpoint = v;
+    else if((v = parse_param(buf, "ralg_trace")) != nullptr)
+      rp.ralg_trace = v;
+    else if((v = parse_param(buf, "checkpoint_interval")) != nullptr)
+      rp.checkpoint_interval = atoi(v);
+    else if((v = parse_param(buf, "lagrange_shrink")) != nullptr)
+      rp.lagrange_shrink = atoi(v) != 0;
+    else if((v = parse_param(buf, "lagrange_coarsen")) != nullptr)
+      rp.lagrange_coarsen = atoi(v);
+    else if((v = parse_param(buf, "lagrange_threads")) != nullptr)
+    {
+      if(strncmp(v, "auto", 4) == 0)
+        rp.lagrange_threads = static_cast<int>(resolve_threads(0));
+      else
+        rp.lagrange_threads = atoi(v);
+    }
+    else if((v = parse_param(buf, "heuristic_threads")) != nullptr)
+    {
+      if(strncmp(v, "auto", 4) == 0)
+        rp.heuristic_threads = static_cast<int>(resolve_threads(0));
+      else
+        rp.heuristic_threads = atoi(v);
+    }
+    else if((v = parse_param(buf, "heuristic_restarts")) != nullptr)
+      rp.heuristic_restarts = atoi(v);
+    else if((v = parse_param(buf, "heuristic_batch")) != nullptr)
+    {
+      if(strncmp(v, "auto", 4) == 0)
+        rp.heuristic_batch = 0;
+      else
+        rp.heuristic_batch = atoi(v);
+    }
+    else if((v = parse_param(buf, "cut_threads")) != nullptr)
+    {
+      if(strncmp(v, "auto", 4) == 0)
+        rp.cut_threads = static_cast<int>(resolve_threads(0));
+      else
+        rp.cut_threads = atoi(v);
+    }
+    else if((v = parse_param(buf, "fixing_threads")) != nullptr)
+    {
+      if(strncmp(v, "auto", 4) == 0)
+        rp.fixing_threads = static_cast<int>(resolve_threads(0));
+      else
+        rp.fixing_threads = atoi(v);
+    }
   }
   fclose(f);
 
@@ -302,6 +361,8 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   clean_nl(rp.distance_file);
   clean_nl(rp.model);
   clean_nl(rp.ralg_hot_start);
+  clean_nl(rp.checkpoint);
+  clean_nl(rp.ralg_trace);
   rp.state[2] = '\0';
 
   if(database.empty() && (rp.dimacs_file.empty() || rp.population_file.empty() || rp.distance_file.empty()))
@@ -352,6 +413,16 @@ run_params read_config(const char* fname, const char* state, const char* ralg_ho
   cout << "k               = " << rp.k << endl;
   cout << "model           = " << rp.model << endl;
   cout << "ralg_hot_start  = " << rp.ralg_hot_start << endl;
+  cout << "lagrange_threads= " << rp.lagrange_threads << endl;
+  cout << "cut_threads     = " << rp.cut_threads << endl;
+  cout << "fixing_threads  = " << rp.fixing_threads << endl;
+  cout << "heuristic_threads = " << rp.heuristic_threads << endl;
+  cout << "heuristic_restarts = " << rp.heuristic_restarts << endl;
+  cout << "heuristic_batch = " << rp.heuristic_batch << endl;
+  cout << "checkpoint      = " << rp.checkpoint << endl;
+  cout << "ralg_trace      = " << rp.ralg_trace << endl;
+  cout << "lagrange_shrink = " << rp.lagrange_shrink << endl;
+  cout << "lagrange_coarsen= " << rp.lagrange_coarsen << endl;
 //  cout << "output          = " << rp.output << endl;
 
   return rp;
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <iostream>
 #include <queue>
+#include <chrono>
 
 #include "districting/common.hpp"
 #include "districting/graph.hpp"
@@ -13,57 +14,442 @@
 #include "districting/ralg.hpp"
 #include "districting/io.hpp"
 
-double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k, 
-  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity)
+// restart ralg on fewer coordinates once at least this fraction of them can be dropped
+const double ShrinkMinFraction = 0.1;
+
+// no coarsening below this many nodes, a cold start is cheap there
+const int CoarseMinNodes = 200;
+// iterations spent on a coarse level, its multipliers are only a starting point
+const int CoarseIterMax = 1000;
+
+void center_pool::add(const vector<bool>& centers, double value)
 {
+  if (capacity == 0 || (best.size() == capacity && value <= best.back().first))
+    return;
+  vector<int> set;
+  for (size_t j = 0; j < centers.size(); ++j)
+    if (centers[j])
+      set.push_back(static_cast<int>(j));
+  auto same = find_if(best.begin(), best.end(), [&set](const pair<double, vector<int>>& e) { return e.second == set; });
+  if (same != best.end())
+  {
+    if (same->first >= value)
+      return;
+    best.erase(same);
+  }
+  else if (best.size() == capacity)
+    best.pop_back();
+  auto pos = find_if(best.begin(), best.end(), [value](const pair<double, vector<int>>& e) { return e.first < value; });
+  best.insert(pos, make_pair(value, set));
+}
+
+vector<vector<int>> center_pool::sets() const
+{
+  vector<vector<int>> ret;
+  for (const auto& e : best)
+    ret.push_back(e.second);
+  return ret;
+}
+
+// runs ralg from [multipliers] (ignored when resuming from a checkpoint), leaves the best multipliers there
+static double solve_dual(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k,
+  vector<vector<double>>& LB1, const run_params& rp, bool exploit_contiguity, double UB, vector<double>& multipliers, int itermax,
+  center_pool* seeds = nullptr)
+{
+  int n = g->nr_nodes;
   double LB = -MYINFINITY;
 
-  vector<double> W(g->nr_nodes, 0);
-  vector<vector<double>> w_hat(g->nr_nodes, vector<double>(g->nr_nodes));
+  // multipliers are [alpha, lambda, upsilon], ralg runs on the coordinates in active
+  // lambda_j and upsilon_j are dropped once LB1[j][j] > UB, j is not a candidate center from then on
+  int full_dim = 3 * n;
+  vector<int> active(full_dim);
+  for (int i = 0; i < full_dim; ++i)
+    active[i] = i;
+  vector<double> base(multipliers); // full multipliers, dropped coordinates keep their last value
+  vector<int> candidates(n); // possible centers
+  for (int j = 0; j < n; ++j)
+    candidates[j] = j;
+  bool shrink = rp.lagrange_shrink && UB < MYINFINITY;
 
-  vector<bool> currentCenters(g->nr_nodes); // centers from most recent inner problem
+  // one workspace per concurrently evaluated line search step
+  unsigned int nr_ws = static_cast<unsigned int>(mymax(rp.lagrange_threads, 1));
+  struct workspace
+  {
+    vector<double> W;
+    vector<vector<double>> w_hat;
+    vector<bool> currentCenters; // centers from most recent inner problem
+    double f_val;
+    vector<double> x; // full multipliers
+    vector<double> grad; // full gradient
+  };
+  vector<workspace> ws(nr_ws);
+  for (workspace& s : ws)
+  {
+    s.W.assign(n, 0);
+    s.w_hat.assign(n, vector<double>(n));
+    s.currentCenters.assign(n, false);
+    s.x.resize(full_dim);
+    s.grad.resize(full_dim);
+  }
 
-  int dim = 3 * g->nr_nodes;
-  double * bestMultipliers = new double[dim]; 
-  double * multipliers = new double[dim];
+  auto cb_eval = [g, &w, &population, L, U, k, &ws, &active, &base, &candidates](const double* multipliers, double& f_val, double* grad, unsigned int t)
+  {
+    workspace& s = ws[t];
+    s.x = base;
+    for (size_t r = 0; r < active.size(); ++r)
+      s.x[active[r]] = multipliers[r];
+    solveInnerProblem(g, s.x.data(), L, U, k, population, w, s.w_hat, s.W, s.grad.data(), f_val, s.currentCenters, candidates);
+    for (size_t r = 0; r < active.size(); ++r)
+      grad[r] = s.grad[active[r]];
+    s.f_val = f_val;
+    return true;
+  };
 
-  auto cb_grad_func = [g, &w, &population, L, U, k, &W, &w_hat, &currentCenters, &LB, &LB1, dim, exploit_contiguity](const double* multipliers, double& f_val, double* grad) 
+  // LB1 is shared, update it only for the points ralg actually visits
+  auto cb_accept = [g, &ws, &LB, &LB1, &candidates, exploit_contiguity, seeds](unsigned int t)
   {
-    solveInnerProblem(g, multipliers, L, U, k, population, w, w_hat, W, grad, f_val, currentCenters);
+    const workspace& s = ws[t];
+    if (seeds)
+      seeds->add(s.currentCenters, s.f_val);
     if (exploit_contiguity)
-      update_LB_contiguity(g, W, currentCenters, f_val, w_hat, LB1);
+      update_LB_contiguity(g, s.W, s.currentCenters, s.f_val, s.w_hat, LB1, candidates);
     else
-      update_LB(W, currentCenters, f_val, w_hat, LB1);
+      update_LB(s.W, s.currentCenters, s.f_val, s.w_hat, LB1, candidates);
 
     // update incubments?
-    if (f_val > LB)
-      LB = f_val;
+    if (s.f_val > LB)
+      LB = s.f_val;
+  };
+
+  // periodic checkpoints of the whole ralg state and LB1
+  const char* checkpoint_fname = rp.checkpoint.empty() ? nullptr : rp.checkpoint.c_str();
+  bool resume = checkpoint_fname && rp.resume && peek_lagrange_checkpoint(checkpoint_fname, n, active);
+  if (resume)
+  {
+    // candidates are the centers whose lambda is still active
+    vector<bool> is_active(full_dim, false);
+    for (int i : active)
+      is_active[i] = true;
+    candidates.clear();
+    for (int j = 0; j < n; ++j)
+      if (is_active[n + j])
+        candidates.push_back(j);
+  }
+  auto last_checkpoint = chrono::steady_clock::now();
+
+  // state to restart from after dropping coordinates
+  vector<double> restart_x;
+  vector<double> restart_B;
+  vector<int> restart_keep; // positions in active that stay
+  ralg_state restart_state;
 
+  auto cb_iter = [&](const ralg_state& st)
+  {
+    if (checkpoint_fname)
+    {
+      chrono::duration<double> since = chrono::steady_clock::now() - last_checkpoint;
+      if (since.count() >= rp.checkpoint_interval)
+      {
+        if (dump_lagrange_checkpoint(checkpoint_fname, st, active, base, LB, LB1))
+          printf("Checkpoint on iter %u written to %s\n", st.iter, checkpoint_fname);
+        last_checkpoint = chrono::steady_clock::now();
+      }
+    }
+    if (shrink)
+    {
+      vector<bool> drop(n, false);
+      int nr_drop = 0;
+      for (int j : candidates)
+        if (LB1[j][j] > UB + VarFixingEpsilon)
+        {
+          drop[j] = true;
+          nr_drop++;
+        }
+      int dim = active.size();
+      if (nr_drop > 0 && static_cast<int>(candidates.size()) - nr_drop >= k && 2 * nr_drop >= ShrinkMinFraction * dim)
+      {
+        restart_keep.clear();
+        for (int r = 0; r < dim; ++r)
+        {
+          int j = active[r] % n;
+          if (active[r] < n || !drop[j])
+            restart_keep.push_back(r);
+        }
+        // warm start with the rows and columns of B that stay
+        int new_dim = restart_keep.size();
+        restart_B.resize(static_cast<size_t>(new_dim) * new_dim);
+        restart_x.resize(new_dim);
+        for (int r = 0; r < new_dim; ++r)
+        {
+          const double* B_row = st.B + static_cast<size_t>(restart_keep[r]) * dim;
+          for (int c = 0; c < new_dim; ++c)
+            restart_B[static_cast<size_t>(r) * new_dim + c] = B_row[restart_keep[c]];
+          restart_x[r] = st.xk[restart_keep[r]];
+        }
+        for (int r = 0; r < dim; ++r)
+          base[active[r]] = st.xk[r];
+        restart_state = st;
+        printf("Lagrangian: %d centers cannot beat UB = %.2lf, dimension %d -> %d\n", nr_drop, UB, dim, new_dim);
+        return false;
+      }
+    }
+    return true;
+  };
+
+  bool restarting = false;
+  auto cb_resume = [&](ralg_state& st)
+  {
+    if (!restarting)
+      return read_lagrange_checkpoint(checkpoint_fname, st, active, base, LB, LB1);
+    st.iter = restart_state.iter;
+    st.nr_matrix_reset = restart_state.nr_matrix_reset;
+    st.step = restart_state.step;
+    std::copy(restart_x.begin(), restart_x.end(), st.xk);
+    std::copy(restart_x.begin(), restart_x.end(), st.res);
+    std::copy(restart_B.begin(), restart_B.end(), st.B);
+    st.evaluated = false; // the function changed
     return true;
   };
 
+  ralg_options opt = defaultOptions; opt.output_iter = 1; opt.is_monotone = false;
+  opt.ls_parallel = nr_ws;
+  ralg_trace* trace = nullptr;
+  if (!rp.ralg_trace.empty())
+  {
+    trace = new ralg_trace(rp.ralg_trace.c_str());
+    if (trace->ok())
+    {
+      opt.trace = trace;
+      opt.output_iter = defaultOptions.output_iter; // the trace has every iteration
+    }
+  }
+  opt.itermax = itermax;
+
+  // after a restart the dual function is that of the problem without the dropped centers,
+  // its values bound min(OPT, UB) from below, which is all the fixing needs
+  while (true)
+  {
+    int dim = active.size();
+    vector<double> x0(dim);
+    vector<double> res(dim);
+    for (int r = 0; r < dim; ++r)
+      x0[r] = base[active[r]];
+    restart_keep.clear();
+    double round_LB = ralg(&opt, cb_eval, cb_accept, dim, x0.data(), res.data(), RALG_MAX,
+      (checkpoint_fname || shrink) ? cb_iter : std::function<bool (const ralg_state&)>(),
+      (resume || restarting) ? cb_resume : std::function<bool (ralg_state&)>()); // lower bound from lagrangian
+    LB = mymax(LB, round_LB);
+
+    multipliers = base;
+    for (int r = 0; r < dim; ++r)
+      multipliers[active[r]] = res[r];
+
+    if (restart_keep.empty())
+      break;
+
+    // drop the coordinates and the centers, x_ij <= x_jj so LB1[j][j] bounds the whole column
+    vector<bool> stays(n, false);
+    vector<int> new_active;
+    for (int r : restart_keep)
+    {
+      new_active.push_back(active[r]);
+      if (active[r] >= n)
+        stays[active[r] % n] = true;
+    }
+    vector<int> new_candidates;
+    for (int j : candidates)
+      if (stays[j])
+        new_candidates.push_back(j);
+      else
+        for (int i = 0; i < n; ++i)
+          LB1[i][j] = mymax(LB1[i][j], LB1[j][j]);
+    active.swap(new_active);
+    candidates.swap(new_candidates);
+    resume = false;
+    restarting = true;
+  }
+
+  delete trace; // flush
+
+  return LB;
+}
+
+// merges adjacent clusters pairwise (cheapest merge first, smallest clusters first) until at most [target]
+// clusters are left or no merge keeps the population within [max_pop]; returns the number of clusters,
+// cluster[i] is the cluster of node i and rep[c] the most populated node of cluster c
+static int coarsen(graph* g, const vector<vector<double>>& w, const vector<int>& population, int max_pop, int target,
+  vector<int>& cluster, vector<int>& rep)
+{
+  int n = g->nr_nodes;
+  int nc = n;
+  cluster.resize(n);
+  rep.resize(n);
+  vector<long> pop(n);
+  for (int i = 0; i < n; ++i)
+  {
+    cluster[i] = i;
+    rep[i] = i;
+    pop[i] = population[i];
+  }
+
+  while (nc > target)
+  {
+    vector<vector<int>> adj(nc);
+    for (int i = 0; i < n; ++i)
+      for (int nb : g->nb(i))
+        if (cluster[i] != cluster[nb])
+          adj[cluster[i]].push_back(cluster[nb]);
+
+    vector<int> order(nc);
+    for (int c = 0; c < nc; ++c)
+      order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&pop](int a, int b) { return pop[a] < pop[b]; });
+
+    vector<int> mate(nc, -1);
+    for (int a : order)
+    {
+      if (mate[a] != -1)
+        continue;
+      int best = -1;
+      double best_cost = MYINFINITY;
+      for (int b : adj[a])
+      {
+        if (mate[b] != -1 || pop[a] + pop[b] > max_pop)
+          continue;
+        double cost = w[rep[a]][rep[b]] + w[rep[b]][rep[a]];
+        if (cost < best_cost)
+        {
+          best = b;
+          best_cost = cost;
+        }
+      }
+      if (best != -1)
+      {
+        mate[a] = best;
+        mate[best] = a;
+      }
+    }
+
+    vector<int> id(nc);
+    int new_nc = 0;
+    for (int c = 0; c < nc; ++c)
+      if (mate[c] == -1 || c < mate[c])
+        id[c] = new_nc++;
+      else
+        id[c] = id[mate[c]];
+    if (new_nc == nc)
+      break;
+
+    vector<int> new_rep(new_nc, -1);
+    vector<long> new_pop(new_nc, 0);
+    for (int c = 0; c < nc; ++c)
+    {
+      new_pop[id[c]] += pop[c];
+      if (new_rep[id[c]] == -1 || population[rep[c]] > population[new_rep[id[c]]])
+        new_rep[id[c]] = rep[c];
+    }
+    for (int i = 0; i < n; ++i)
+      cluster[i] = id[cluster[i]];
+    rep.swap(new_rep);
+    pop.swap(new_pop);
+    nc = new_nc;
+  }
+  rep.resize(nc);
+  return nc;
+}
+
+// starting multipliers without a hot start file: the multipliers of a coarsened instance (itself started
+// the same way) prolonged to the nodes, or 1 if rp.lagrange_coarsen is off or the graph is small
+static void cold_start(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k,
+  const run_params& rp, vector<double>& multipliers)
+{
+  int n = g->nr_nodes;
+  multipliers.assign(3 * n, 1.); // whatever
+  if (rp.lagrange_coarsen <= 1 || n <= CoarseMinNodes)
+    return;
+
+  // a coarse node is assigned as a whole, to the representative of the coarse center
+  vector<int> cluster, rep;
+  int nc = coarsen(g, w, population, U / 2, n / rp.lagrange_coarsen, cluster, rep);
+  if (nc == n || nc < 2 * k)
+    return;
+
+  graph gc(nc);
+  vector<int> pop_c(nc, 0);
+  for (int i = 0; i < n; ++i)
+  {
+    pop_c[cluster[i]] += population[i];
+    for (int nb : g->nb(i))
+      if (cluster[i] < cluster[nb])
+        gc.add_edge(cluster[i], cluster[nb]);
+  }
+  vector<vector<double>> w_c(nc, vector<double>(nc, 0.));
+  for (int i = 0; i < n; ++i)
+  {
+    vector<double>& row = w_c[cluster[i]];
+    for (int c = 0; c < nc; ++c)
+      row[c] += w[i][rep[c]];
+  }
+
+  vector<double> x_c;
+  cold_start(&gc, w_c, pop_c, L, U, k, rp, x_c);
+
+  // a plain run: no checkpoints, no trace, no shrinking, the coarse bounds are of no use
+  run_params coarse_rp = rp;
+  coarse_rp.checkpoint.clear();
+  coarse_rp.ralg_trace.clear();
+  coarse_rp.resume = false;
+  coarse_rp.lagrange_shrink = false;
+  vector<vector<double>> LB1_c(nc, vector<double>(nc, -MYINFINITY));
+  auto coarse_start = chrono::steady_clock::now();
+  double LB_c = solve_dual(&gc, w_c, pop_c, L, U, k, LB1_c, coarse_rp, false, MYINFINITY, x_c, CoarseIterMax);
+  chrono::duration<double> coarse_duration = chrono::steady_clock::now() - coarse_start;
+  printf("Lagrangian warm start: %d -> %d nodes, coarse value %.2lf in %.2lf seconds\n", n, nc, LB_c, coarse_duration.count());
+
+  // alpha_c is the multiplier of the sum of its nodes' assignment constraints, split it by population;
+  // population bounds of coarse center c apply to every node of c as a center
+  vector<int> size_c(nc, 0);
+  for (int i = 0; i < n; ++i)
+    size_c[cluster[i]]++;
+  for (int i = 0; i < n; ++i)
+  {
+    int c = cluster[i];
+    double share = pop_c[c] > 0 ? static_cast<double>(population[i]) / pop_c[c] : 1. / size_c[c];
+    multipliers[i] = x_c[c] * share;
+    multipliers[n + i] = x_c[nc + c];
+    multipliers[2 * n + i] = x_c[2 * nc + c];
+  }
+}
+
+double solveLagrangian(graph* g, const vector<vector<double>>& w, const vector<int> &population, int L, int U, int k, 
+  vector<vector<double>>& LB1, bool ralg_hot_start, const char* ralg_hot_start_fname, const run_params& rp, bool exploit_contiguity, double UB,
+  center_pool* seeds)
+{
+  int n = g->nr_nodes;
+  vector<double> multipliers;
+
   // try to load hot start if any
   if (ralg_hot_start)
-    read_ralg_hot_start(ralg_hot_start_fname, multipliers, dim);
+  {
+    multipliers.assign(3 * n, 1.);
+    read_ralg_hot_start(ralg_hot_start_fname, multipliers.data(), 3 * n);
+  }
+  else if (rp.resume && !rp.checkpoint.empty())
+    multipliers.assign(3 * n, 1.); // the checkpoint has the point
   else
-    for (int i = 0; i < dim; ++i)
-      multipliers[i] = 1.; // whatever
+    cold_start(g, w, population, L, U, k, rp, multipliers);
 
-  ralg_options opt = defaultOptions; opt.output_iter = 1; opt.is_monotone = false;
-  if (ralg_hot_start) opt.itermax = 100;
-  LB = ralg(&opt, cb_grad_func, dim, multipliers, bestMultipliers, RALG_MAX); // lower bound from lagrangian
+  double LB = solve_dual(g, w, population, L, U, k, LB1, rp, exploit_contiguity, UB, multipliers,
+    ralg_hot_start ? 100 : defaultOptions.itermax, seeds);
 
   // dump result to "state_model.hot"
-  dump_ralg_hot_start(rp, bestMultipliers, dim, LB);
-
-  delete [] multipliers;
-  delete [] bestMultipliers;
+  dump_ralg_hot_start(rp, multipliers.data(), 3 * n, LB);
 
   return LB;
 }
 
 void update_LB(const vector<double>& W, const vector<bool>& currentCenters, double f_val, 
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1)
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, const vector<int>& candidates)
 {
   int n = currentCenters.size();
   double maxW = -MYINFINITY;
@@ -78,8 +464,8 @@ void update_LB(const vector<double>& W, const vector<bool>& currentCenters, doub
     if (!currentCenters[i])
       minW = mymin(minW, W[i]);
 
-  // update LB1
-  for (int j = 0; j < n; ++j)
+  // update LB1, columns of centers no longer possible stay as they are
+  for (int j : candidates)
   {
     if (!currentCenters[j])
     {
@@ -103,7 +489,7 @@ void update_LB(const vector<double>& W, const vector<bool>& currentCenters, doub
 }
 
 void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>& currentCenters, double f_val,
-  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1)
+  const vector<vector<double>> &w_hat, vector< vector<double> > &LB1, const vector<int>& candidates)
 {
   int n = currentCenters.size();
   double maxW = -MYINFINITY;
@@ -115,7 +501,7 @@ void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>&
 
   // compute special distances 
   vector<double> dist(g->nr_nodes);
-  for (int j = 0; j < n; ++j)
+  for (int j : candidates)
   {
     // a particular shortest path computation from j to all nodes
     priority_queue< pair<double, int>, vector <pair<double, int>>, greater<pair<double, int>> > pq;
@@ -151,7 +537,8 @@ void update_LB_contiguity(graph* g, const vector<double>& W, const vector<bool>&
 }
 
 void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k, const vector<int>& population,
-  const vector<vector<double>>& w, vector<vector<double>>& w_hat, vector<double>& W, double* grad, double& f_val, vector<bool>& currentCenters)
+  const vector<vector<double>>& w, vector<vector<double>>& w_hat, vector<double>& W, double* grad, double& f_val, vector<bool>& currentCenters,
+  const vector<int>& candidates)
 {
   const double *alpha = multipliers;
   const double *lambda = multipliers + g->nr_nodes;
@@ -166,7 +553,7 @@ void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k,
   {
     double pOverL = static_cast<double>(population[i]) / static_cast<double>(L);
     double pOverU = static_cast<double>(population[i]) / static_cast<double>(U);
-    for (int j = 0; j < g->nr_nodes; ++j)
+    for (int j : candidates)
     {
       // w[i][i] == 0?
       w_hat[i][j] = w[i][j] - alpha[i] - myabs(lambda[j]) * pOverL + myabs(upsilon[j]) * pOverU;
@@ -176,7 +563,7 @@ void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k,
   }
 
   // recompute W_j, the minimum obj value for district centered at j
-  for (int j = 0; j < g->nr_nodes; ++j)
+  for (int j : candidates)
   {
     W[j] = w_hat[j][j]; 
     for (int i = 0; i < g->nr_nodes; ++i)
@@ -185,9 +572,7 @@ void solveInnerProblem(graph* g, const double* multipliers, int L, int U, int k,
   }
 
   // select k smallest
-  vector<int> W_indices(W.size());
-  for (size_t i = 0; i < W.size(); ++i)
-    W_indices[i] = i;
+  vector<int> W_indices(candidates);
   std::sort(W_indices.begin(), W_indices.end(), [&W](int i1, int i2) {
     return W[i1] < W[i2];
   });
@@ -15,8 +15,6 @@
 #include "districting/common.hpp"
 #include "districting/version.hpp"
 
-const double VarFixingEpsilon = 0.00001;
-
 using namespace std;
 template <typename T>
 void dealloc_vec(vector<T>& v, const char* name)
@@ -30,12 +28,26 @@ void dealloc_vec(vector<T>& v, const char* name)
 int main(int argc, char *argv[])
 {
   printf("Districting, build %s\n", gitversion);
+
+  // --resume may appear anywhere, the remaining arguments are positional
+  bool resume = false;
+  int nargs = 0;
+  for (int i = 0; i < argc; ++i)
+    if (strcmp(argv[i], "--resume") == 0)
+      resume = true;
+    else
+      argv[nargs++] = argv[i];
+  argc = nargs;
+
   if (argc < 2) {
-    printf("Usage: %s <config> [state [ralg_hot_start]]\n\
+    printf("Usage: %s [--resume] <config> [state [ralg_hot_start]]\n\
+  --resume continues the Lagrangian from the checkpoint given in config\n\
   Available models:\n\
   \thess\t\tHess model\n\
   \tshir\t\tHess model with SHIR\n\
   \tmcf\t\tHess model with MCF\n\
+  \tlmcf\t\tHess model with MCF, commodities added as solutions use them\n\
+  \tlshir\t\tHess model with SHIR, commodities added for disconnected districts\n\
   \tcut\t\tHess model with CUT\n\
   \tlcut\t\tHess model with LCUT\n", argv[0]);
     return 0;
@@ -44,6 +56,9 @@ int main(int argc, char *argv[])
   // parse config
   run_params rp;
   rp = read_config(argv[1], (argc>2 ? argv[2] : ""), (argc>3 ? argv[3] : ""));
+  rp.resume = resume;
+  if (resume && rp.checkpoint.empty())
+    printf("WARNING: --resume without checkpoint in config, starting from scratch\n");
   int L = rp.L; int U = rp.U;
   bool ralg_hot_start = !rp.ralg_hot_start.empty();
   const char* ralg_hot_start_fname = (rp.ralg_hot_start.empty() ? nullptr : rp.ralg_hot_start.c_str());
@@ -116,84 +131,125 @@ int main(int argc, char *argv[])
 
   auto start = chrono::steady_clock::now();
 
-  // apply Lagrangian 
-  vector< vector<double> > LB1(nr_nodes, vector<double>(nr_nodes, -MYINFINITY)); // LB1[i][j] is a lower bound on problem objective if we fix x[i][j] = 1
-  auto lagrange_start = chrono::steady_clock::now();
-  double LB = solveLagrangian(g, w, population, L, U, k, LB1, ralg_hot_start, ralg_hot_start_fname, rp, exploit_contiguity); // lower bound on problem objective, coming from lagrangian
-  chrono::duration<double> lagrange_duration = chrono::steady_clock::now() - lagrange_start;
-  ffprintf(rp.output, "%.2lf, %.2lf, ", LB, lagrange_duration.count());
+  // the heuristics do not depend on the Lagrangian, run them first so that their UB can be used to
+  // shrink the Lagrangian; the output columns keep their order
+  string heuristic_columns;
+  auto dump_column = [&heuristic_columns](double val) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.2lf, ", val);
+    heuristic_columns += buf;
+  };
+  auto dump_maybe_inf = [&](double val) { if (myabs(val-MYINFINITY) <= 1.) heuristic_columns += "infinity, "; else dump_column(val); };
 
-  auto dump_maybe_inf = [&rp](double val) { if (myabs(val-MYINFINITY) <= 1.) ffprintf(rp.output, "infinity, "); else ffprintf(rp.output, "%.2lf, ", val); };
+  cut_pool pool; // separators found by the heuristics, injected into the main cut model
+  // one Gurobi environment for everything and one restricted model shared by the heuristics
+  restricted_session session(g, w, population, L, U, k);
 
   // run a heuristic
   double UB = MYINFINITY;
-  int maxIterations = 10;   // 10 iterations is often sufficient
+  int maxIterations = rp.heuristic_restarts;
   auto heuristic_start = chrono::steady_clock::now();
-  vector<int> heuristicSolution = HessHeuristic(g, w, population, L, U, k, UB, maxIterations, false);
+  vector<int> heuristicSolution = HessHeuristic(g, w, population, L, U, k, UB, maxIterations, false, rp.heuristic_threads,
+    static_cast<unsigned int>(mymax(rp.heuristic_batch, 0)), &session);
   chrono::duration<double> heuristic_duration = chrono::steady_clock::now() - heuristic_start;
   dump_maybe_inf(UB);
-  ffprintf(rp.output, "%.2lf, ", heuristic_duration.count());
+  dump_column(heuristic_duration.count());
   printf("Best solution after %d of HessHeuristic is %.2lf\n", maxIterations, UB);
 
   // run local search
   auto LS_start = chrono::steady_clock::now();
-  bool ls_ok = LocalSearch(g, w, population, L, U, k, heuristicSolution, UB);
+  bool ls_ok = LocalSearch(g, w, population, L, U, k, heuristicSolution, UB, rp.heuristic_threads, &session);
   chrono::duration<double> LS_duration = chrono::steady_clock::now() - LS_start;
   dump_maybe_inf(UB);
-  ffprintf(rp.output, "%.2lf, ", LS_duration.count());
+  dump_column(LS_duration.count());
   printf("Best solution after local search is %.2lf\n", UB);
+  double hessUB = UB; // without contiguity
 
+  // cut models solve it with their own callback, so the separators found carry over to the main model
+  bool cut_model = (arg_model == "cut" || arg_model == "lcut");
   if (arg_model != "hess" && ls_ok)  // solve contiguity-constrained problem, restricted to centers from heuristicSolution
   {
     UB = MYINFINITY;
     auto contiguity_start = chrono::steady_clock::now();
-    ContiguityHeuristic(heuristicSolution, g, w, population, L, U, k, UB, "shir"); // arg_model);
+    ContiguityHeuristic(heuristicSolution, g, w, population, L, U, k, UB, cut_model ? arg_model : "shir", &pool, &session);
     chrono::duration<double> contiguity_duration = chrono::steady_clock::now() - contiguity_start;
     dump_maybe_inf(UB);
-    ffprintf(rp.output, "%.2lf, ", contiguity_duration.count());
-  } else ffprintf(rp.output, "n/a, n/a, ");
+    dump_column(contiguity_duration.count());
+  } else heuristic_columns += "n/a, n/a, ";
+
+  // apply Lagrangian 
+  vector< vector<double> > LB1(nr_nodes, vector<double>(nr_nodes, -MYINFINITY)); // LB1[i][j] is a lower bound on problem objective if we fix x[i][j] = 1
+  auto lagrange_start = chrono::steady_clock::now();
+  center_pool seeds(rp.heuristic_restarts); // best center sets of the inner problems
+  double LB = solveLagrangian(g, w, population, L, U, k, LB1, ralg_hot_start, ralg_hot_start_fname, rp, exploit_contiguity, UB, &seeds); // lower bound on problem objective, coming from lagrangian
+  chrono::duration<double> lagrange_duration = chrono::steady_clock::now() - lagrange_start;
+  ffprintf(rp.output, "%.2lf, %.2lf, ", LB, lagrange_duration.count());
+  ffprintf(rp.output, "%s", heuristic_columns.c_str());
+
+  // Hess descents from the center sets of the Lagrangian, a better UB fixes more below
+  if (seeds.size() > 0)
+  {
+    vector<vector<int>> seed_sets = seeds.sets();
+    double seededUB = hessUB;
+    vector<int> seededSolution = HessHeuristic(g, w, population, L, U, k, seededUB, static_cast<int>(seed_sets.size()), false,
+      rp.heuristic_threads, static_cast<unsigned int>(mymax(rp.heuristic_batch, 0)), &session, &seed_sets);
+    if (seededUB < hessUB && LocalSearch(g, w, population, L, U, k, seededSolution, seededUB, rp.heuristic_threads, &session))
+    {
+      printf("Lagrangian center sets improve the heuristic from %.2lf to %.2lf\n", hessUB, seededUB);
+      double seededContiguousUB = seededUB;
+      if (arg_model != "hess")
+      {
+        seededContiguousUB = MYINFINITY;
+        ContiguityHeuristic(seededSolution, g, w, population, L, U, k, seededContiguousUB, cut_model ? arg_model : "shir", &pool, &session);
+      }
+      if (seededContiguousUB < UB)
+      {
+        UB = seededContiguousUB;
+        heuristicSolution = seededSolution;
+        ls_ok = true;
+        printf("UB from the Lagrangian center sets = %.2lf\n", UB);
+      }
+    }
+  }
+  session.release_model(); // the heuristics are done, the environment is kept for the full model
 
   // determine which variables can be fixed
-  vector<vector<bool>> F0(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_0
-  vector<vector<bool>> F1(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_1
+  auto F = make_shared<fixing_matrix>(nr_nodes); // F_0 and F_1, shared with the model
   for (int i = 0; i < nr_nodes; ++i)
     for (int j = 0; j < nr_nodes; ++j)
-      if (LB1[i][j] > UB + VarFixingEpsilon) F0[i][j] = true;
+      if (LB1[i][j] > UB + VarFixingEpsilon) F->fix_zero(i, j);
   // LB1 is not used anymore, release memory
   dealloc_vec(LB1, "LB1");
+  // under contiguity a and b can't share a district if every a-b path is too populous
+  if (arg_model != "hess")
+  {
+    size_t numFixedDist = fix_population_distance(*F, g, population, U, static_cast<unsigned int>(mymax(rp.fixing_threads, 1)));
+    printf("Number of vars fixed by population distance = %zu\n", numFixedDist);
+  }
   //report the number of fixings
-  int numFixedZero = 0;
-  int numFixedOne = 0;
-  int numUnfixed = 0;
+  size_t numFixedZero = F->count_zero();
+  size_t numFixedOne = F->count_one();
+  size_t numUnfixed = static_cast<size_t>(nr_nodes) * nr_nodes - numFixedZero - numFixedOne;
   int numCentersLeft = 0;
   for (int i = 0; i < nr_nodes; ++i)
-  {
-    if (!F0[i][i]) numCentersLeft++;
-    for (int j = 0; j < nr_nodes; ++j)
-    {
-      if (F0[i][j]) numFixedZero++;
-      else if (F1[i][j]) numFixedOne++;
-      else numUnfixed++;
-    }
-  }
+    if (!F->is_zero(i, i)) numCentersLeft++;
   printf("\n");
-  printf("Number of variables fixed to zero = %d\n", numFixedZero);
-  printf("Number of variables fixed to one  = %d\n", numFixedOne);
-  printf("Number of variables not fixed     = %d\n", numUnfixed);
+  printf("Number of variables fixed to zero = %zu\n", numFixedZero);
+  printf("Number of variables fixed to one  = %zu\n", numFixedOne);
+  printf("Number of variables not fixed     = %zu\n", numUnfixed);
   printf("Number of centers left            = %d\n", numCentersLeft);
-  double perc_var_fixed = (double)(nr_nodes*nr_nodes - numUnfixed) / (nr_nodes*nr_nodes);
+  double perc_var_fixed = (double)(numFixedZero + numFixedOne) / ((double)nr_nodes * nr_nodes);
   printf("Percentage of vars fixed = %.2lf\n", perc_var_fixed);
   ffprintf(rp.output, "%.2lf, ", perc_var_fixed);
 
   try
   {
-    // initialize environment and create an empty model
-    GRBEnv env = GRBEnv();
-    GRBModel model = GRBModel(env);
+    // create an empty model in the environment of the heuristics
+    GRBModel model = GRBModel(session.environment());
 
     // get incumbent solution using centers from lagrangian
     hess_params p;
-    p = build_hess(&model, g, w, population, L, U, k, F0, F1);
+    p = build_hess(&model, g, w, population, L, U, k, F);
 
     // push GUROBI to branch over clusterheads
     for (int i = 0; i < nr_nodes; ++i)
@@ -201,22 +257,27 @@ int main(int argc, char *argv[])
         X_V(i, i).set(GRB_IntAttr_BranchPriority, 1);
 
     HessCallback* cb = nullptr;
+    LazyFlow* lazy = nullptr;
 
     if (arg_model == "shir")
       build_shir(&model, p, g);
     else if (arg_model == "mcf")
       build_mcf(&model, p, g);
+    else if (arg_model == "lmcf")
+      lazy = build_lmcf(&model, p, g);
+    else if (arg_model == "lshir")
+      lazy = build_lshir(&model, p, g);
     else if (arg_model == "cut")
-      cb = build_cut(&model, p, g, population);
+      cb = build_cut(&model, p, g, population, &pool, rp.cut_threads);
     else if (arg_model == "lcut")
-      cb = build_lcut(&model, p, g, population, U);
+      cb = build_lcut(&model, p, g, population, U, &pool, rp.cut_threads);
     else if (arg_model != "hess") {
       printf("ERROR: Unknown model : %s\n", arg_model.c_str());
       exit(1);
     }
 
     // preserve memory here
-    if(!cb)
+    if(!cb && !lazy)
     {
       delete g;
       g = nullptr;
@@ -231,15 +292,13 @@ int main(int argc, char *argv[])
 
     //provide IP warm start 
     if(ls_ok)
+    {
+      vector<double> x_start(p.h.size(), 0.);
       for (int i = 0; i < nr_nodes; ++i)
-      {
-        for (int j = 0; j < nr_nodes; ++j)
-          if (IS_X(i, j))
-            X_V(i, j).set(GRB_DoubleAttr_Start, 0);
-
         if (IS_X(i, heuristicSolution[i]))
-          X_V(i, heuristicSolution[i]).set(GRB_DoubleAttr_Start, 1);
-      }
+          x_start[X_I(i, heuristicSolution[i])] = 1.;
+      model.set(GRB_DoubleAttr_Start, p.x, x_start.data(), static_cast<int>(x_start.size()));
+    }
 
     // calculate overtly
     int max_pv = population[0];
@@ -253,7 +312,10 @@ int main(int argc, char *argv[])
     //optimize the model
     auto IP_start = chrono::steady_clock::now();
 
-    model.optimize();
+    if (lazy)
+      lazy->optimize(&model);
+    else
+      model.optimize();
 
     chrono::duration<double> IP_duration = chrono::steady_clock::now() - IP_start;
     ffprintf(rp.output, "%.2lf, ", IP_duration.count());
@@ -264,11 +326,19 @@ int main(int argc, char *argv[])
     if (cb)
     {
       printf("Number of callbacks: %d\n", cb->numCallbacks);
+      printf("Number of fractional separation callbacks: %d\n", cb->numNodeCallbacks);
       printf("Time in callbacks: %lf seconds\n", cb->callbackTime);
       printf("Number of lazy constraints generated: %d\n", cb->numLazyCuts);
+      printf("Number of user cuts generated: %d\n", cb->numUserCuts);
       ffprintf(rp.output, "%d, %.2lf, %d, ", cb->numCallbacks, cb->callbackTime, cb->numLazyCuts);
       delete cb;
     } else ffprintf(rp.output, "n/a, n/a, n/a, ");
+    if (lazy)
+    {
+      printf("Number of lazy flow solves: %d\n", lazy->numRounds);
+      printf("Number of lazy flow blocks added: %d\n", lazy->numBlocks);
+      delete lazy;
+    }
 
     ffprintf(rp.output, "%.2lf, ", static_cast<double>(max_pv) / static_cast<double>(U));
 
@@ -60,10 +60,6 @@ int main(int argc, char *argv[])
       w[i][j] = get_objective_coefficient(dist, population, i, j);
 
 
-  // determine which variables can be fixed
-  vector<vector<bool>> F0(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_0
-  vector<vector<bool>> F1(nr_nodes, vector<bool>(nr_nodes, false)); // define matrix F_1
-
   auto start = chrono::steady_clock::now();
 
   try
@@ -0,0 +1,77 @@
+#include "districting/parallel.hpp"
+
+thread_pool::thread_pool(unsigned int nr_workers) : job(nullptr), count(0), next(0), generation(0), busy(0), stop(false)
+{
+  for (unsigned int t = 0; t < nr_workers; ++t)
+    workers.emplace_back(&thread_pool::work, this, t + 1);
+}
+
+thread_pool::~thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m);
+    stop = true;
+  }
+  cv_start.notify_all();
+  for (std::thread& t : workers)
+    t.join();
+}
+
+void thread_pool::drain(unsigned int tid)
+{
+  unsigned int i;
+  while ((i = next.fetch_add(1)) < count)
+    (*job)(i, tid);
+}
+
+void thread_pool::work(unsigned int tid)
+{
+  unsigned int seen = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m);
+      cv_start.wait(lock, [this, seen]() { return stop || generation != seen; });
+      if (stop)
+        return;
+      seen = generation;
+    }
+    drain(tid);
+    {
+      std::lock_guard<std::mutex> lock(m);
+      if (--busy == 0)
+        cv_done.notify_one();
+    }
+  }
+}
+
+void thread_pool::run(unsigned int count_, const std::function<void (unsigned int, unsigned int)>& f)
+{
+  if (workers.empty() || count_ <= 1)
+  {
+    for (unsigned int i = 0; i < count_; ++i)
+      f(i, 0);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m);
+    job = &f;
+    count = count_;
+    next = 0;
+    busy = static_cast<unsigned int>(workers.size());
+    generation++;
+  }
+  cv_start.notify_all();
+  drain(0);
+  std::unique_lock<std::mutex> lock(m);
+  cv_done.wait(lock, [this]() { return busy == 0; });
+  job = nullptr;
+}
+
+unsigned int resolve_threads(int requested)
+{
+  if (requested > 0)
+    return static_cast<unsigned int>(requested);
+  unsigned int hw = std::thread::hardware_concurrency();
+  return hw > 0 ? hw : 1;
+}
@@ -4,9 +4,13 @@
 #include <malloc.h>
 #include <cstdio>
 #include <ctime>
+#include <cstring>
+#include <chrono>
 
 #include "cblas.h"
 
+#include "districting/parallel.hpp"
+
 #ifndef min
 #define min(a,b) (((a)<(b))?(a):(b))
 #endif
@@ -37,12 +41,71 @@ void dfree(double** m)
   free(m);
 }
 
+ralg_trace::ralg_trace(const char* fname, size_t capacity) : buf(capacity > 0 ? capacity : 1), used(0)
+{
+  size_t len = strlen(fname);
+  csv = len >= 4 && strcmp(fname + len - 4, ".csv") == 0;
+  f = fopen(fname, csv ? "w" : "wb");
+  if(!f)
+  {
+    printf("Cannot open %s for ralg trace\n", fname);
+    return;
+  }
+  if(csv)
+    fprintf(f, "iter,f_val,step,norm,diff,evals,resets,t_callback,t_blas\n");
+  else
+    fwrite("RALGTRC1", 8, 1, f);
+}
+
+ralg_trace::~ralg_trace()
+{
+  if(f)
+  {
+    flush();
+    fclose(f);
+  }
+}
+
+void ralg_trace::flush()
+{
+  if(f)
+  {
+    if(csv)
+      for(size_t r = 0; r < used; ++r)
+      {
+        const ralg_trace_record& t = buf[r];
+        fprintf(f, "%u,%.14e,%.14e,%.14e,%.14e,%u,%u,%.6e,%.6e\n", t.iter, t.f_val, t.step, t.norm, t.diff,
+          t.nr_evals, t.nr_matrix_reset, t.t_callback, t.t_blas);
+      }
+    else
+      fwrite(buf.data(), sizeof(ralg_trace_record), used, f);
+    fflush(f);
+  }
+  used = 0;
+}
+
 double ralg(const ralg_options* opt,
           std::function<bool (const double*, double&, double*)> cb_grad_and_func,
           unsigned int DIMENSION,
           double* x0,
           double* res,
           bool is_min)
+{
+  ralg_options seq_opt = *opt;
+  seq_opt.ls_parallel = 1; // single workspace
+  return ralg(&seq_opt, [&cb_grad_and_func](const double* x, double& f, double* g, unsigned int) { return cb_grad_and_func(x, f, g); },
+    [](unsigned int) {}, DIMENSION, x0, res, is_min);
+}
+
+double ralg(const ralg_options* opt,
+          std::function<bool (const double*, double&, double*, unsigned int)> cb_eval,
+          std::function<void (unsigned int)> cb_accept,
+          unsigned int DIMENSION,
+          double* x0,
+          double* res,
+          bool is_min,
+          std::function<bool (const ralg_state&)> cb_iter,
+          std::function<bool (ralg_state&)> cb_resume)
 {
   double* xk;
   double** B;
@@ -58,6 +121,22 @@ double ralg(const ralg_options* opt,
   double f_val;
 
   double f_optimal;
+  ralg_state state;
+
+  // line search workspaces
+  unsigned int nr_ws = max(opt->ls_parallel, 1u);
+  double** ws_x; // trial points
+  double** ws_grad;
+  double* ws_step; // step taken to reach the trial point
+  double* ws_f;
+  bool* ws_ok;
+  bool ls_stop;
+
+  // per iteration timings for the trace
+  typedef std::chrono::steady_clock trace_clock;
+  trace_clock::time_point t_iter;
+  double t_callback = 0.;
+  double t_output = 0.; // printing, left out of t_blas
 
   unsigned int nr_matrix_reset = 0;
   printf("Running ralg_blas v2 with matrix renewal, copyright Eugene Lykhovyd, 2014-2018.\n");
@@ -79,20 +158,68 @@ double ralg(const ralg_options* opt,
   tmp = (double*) malloc(sizeof(double)*DIMENSION);
   tmp2 = (double*) malloc(sizeof(double)*DIMENSION);
 
-  cblas_dcopy(DIMENSION, x0, 1, xk, 1);
+  ws_x = (double**) malloc(sizeof(double*)*nr_ws);
+  ws_grad = (double**) malloc(sizeof(double*)*nr_ws);
+  for(i = 0; i < nr_ws; ++i)
+  {
+    ws_x[i] = (double*) malloc(sizeof(double)*DIMENSION);
+    ws_grad[i] = (double*) malloc(sizeof(double)*DIMENSION);
+  }
+  ws_step = (double*) malloc(sizeof(double)*nr_ws);
+  ws_f = (double*) malloc(sizeof(double)*nr_ws);
+  ws_ok = (bool*) malloc(sizeof(bool)*nr_ws);
+
+  thread_pool pool(nr_ws - 1);
+  std::function<void (unsigned int, unsigned int)> eval_trial = [&](unsigned int t, unsigned int) {
+    ws_ok[t] = cb_eval(ws_x[t], ws_f[t], ws_grad[t], t);
+  };
+  if(nr_ws > 1)
+    printf("Speculative line search with %u workspaces\n", nr_ws);
+
+  state.xk = xk;
+  state.grad = grad;
+  state.res = res;
+  state.B = B[0];
+
+  state.evaluated = false;
+  bool resumed = cb_resume && cb_resume(state);
+  if(resumed)
+  {
+    iter = state.iter;
+    nr_matrix_reset = state.nr_matrix_reset;
+    step = state.step;
+    f_val = state.f_val;
+    f_optimal = state.f_optimal;
+    printf("resuming on iter %d\n", iter);
+  }
+  else
+  {
+    cblas_dcopy(DIMENSION, x0, 1, xk, 1);
+    cblas_dcopy(DIMENSION, x0, 1, res, 1);
+  }
   printf("init done\n");
   time_t t_inited = time(NULL);
-  if(!cb_grad_and_func(xk, f_val, grad))
+  if(!resumed || !state.evaluated)
   {
-    printf("grad failed, aborting\n");
-    return 0.;
-  }
+    if(!cb_eval(xk, f_val, grad, 0))
+    {
+      printf("grad failed, aborting\n");
+      return 0.;
+    }
+    cb_accept(0);
 
-  f_optimal = f_val;
+    f_optimal = f_val;
+  }
 
   do
   {
     iter++;
+    if(opt->trace)
+    {
+      t_iter = trace_clock::now();
+      t_callback = 0.;
+      t_output = 0.;
+    }
 
     cblas_dgemv(CblasRowMajor, CblasTrans, DIMENSION, DIMENSION, ((is_min)?(1.):(-1.)), B[0], DIMENSION, grad, 1, 0., tmp, 1);
     d_var = cblas_dnrm2(DIMENSION, tmp, 1);
@@ -114,35 +241,72 @@ double ralg(const ralg_options* opt,
     cblas_dcopy(DIMENSION, grad, 1, tmp, 1);
 
     step_diff = 0.;
+    ls_stop = false;
 
     do
     {
       // tmp2 - min direction
       // tmp - old gradient
       // grad - new graient
-      i++; j++;
-      cblas_daxpy(DIMENSION, -step, tmp2, 1, xk, 1);
-
-      step_diff = step_diff + step;
-
-      if(!cb_grad_and_func(xk, f_val, grad))
+      // the steps do not depend on the function values, so the next nr_ws trial points are known in advance
+      double next_step = step;
+      unsigned int next_i = i;
+      for(unsigned int t = 0; t < nr_ws; ++t)
       {
-        printf("grad failed\n");
-        break;
+        cblas_dcopy(DIMENSION, (t == 0) ? xk : ws_x[t-1], 1, ws_x[t], 1);
+        cblas_daxpy(DIMENSION, -next_step, tmp2, 1, ws_x[t], 1);
+        ws_step[t] = next_step;
+        if(++next_i == opt->nh)
+        {
+          next_step = next_step * opt->q2;
+          next_i = 0;
+        }
       }
-      if(i == opt->nh)
+      trace_clock::time_point t_cb;
+      if(opt->trace)
+        t_cb = trace_clock::now();
+      pool.run(nr_ws, eval_trial);
+      if(opt->trace)
+        t_callback += std::chrono::duration<double>(trace_clock::now() - t_cb).count();
+
+      // replay the trials as the sequential line search would do
+      for(unsigned int t = 0; t < nr_ws; ++t)
       {
-        step = step * opt->q2;
-        i = 0;
-      }
-      if(((is_min)?(1.):(-1.))*cblas_ddot(DIMENSION, grad, 1, tmp2, 1) <= 0.)
+        i++; j++;
+        cblas_dcopy(DIMENSION, ws_x[t], 1, xk, 1);
+
+        step_diff = step_diff + ws_step[t];
+
+        if(!ws_ok[t])
+        {
+          printf("grad failed\n");
+          ls_stop = true;
           break;
-      if(j > opt->stepmax)
-      {
-        printf("function is unbounded, done %d steps, current step %.14e\n", j, step);
-        return 0.;
+        }
+        f_val = ws_f[t];
+        cblas_dcopy(DIMENSION, ws_grad[t], 1, grad, 1);
+        if(opt->trace)
+          t_cb = trace_clock::now();
+        cb_accept(t);
+        if(opt->trace)
+          t_callback += std::chrono::duration<double>(trace_clock::now() - t_cb).count();
+        if(i == opt->nh)
+        {
+          step = step * opt->q2;
+          i = 0;
+        }
+        if(((is_min)?(1.):(-1.))*cblas_ddot(DIMENSION, grad, 1, tmp2, 1) <= 0.)
+        {
+          ls_stop = true;
+          break;
+        }
+        if(j > opt->stepmax)
+        {
+          printf("function is unbounded, done %d steps, current step %.14e\n", j, step);
+          return 0.;
+        }
       }
-    } while(1);
+    } while(!ls_stop);
 
     if(!opt->is_monotone)
     {
@@ -170,7 +334,12 @@ double ralg(const ralg_options* opt,
     d_var = cblas_dnrm2(DIMENSION, tmp2, 1);
     if (opt->output && (iter-1) % opt->output_iter == 0)
     {
+        trace_clock::time_point t_out;
+        if(opt->trace)
+          t_out = trace_clock::now();
         printf("iter = %d, step = %.14e, func = %.14e, norm = %.14e, diff = %.14e\n", iter, step, f_val, d_var, step_diff);
+        if(opt->trace)
+          t_output += std::chrono::duration<double>(trace_clock::now() - t_out).count();
     }
     if(d_var > opt->reset)
     {
@@ -180,7 +349,12 @@ double ralg(const ralg_options* opt,
     }
     else
     {
+      trace_clock::time_point t_out;
+      if(opt->trace)
+        t_out = trace_clock::now();
       printf("Matrix reset on iter %d\n", iter);
+      if(opt->trace)
+        t_output += std::chrono::duration<double>(trace_clock::now() - t_out).count();
 
       nr_matrix_reset ++;
       cblas_dscal(DIMENSION*DIMENSION, 0, B[0], 1);
@@ -189,11 +363,42 @@ double ralg(const ralg_options* opt,
       step = step_diff / opt->nh;
     }
 
+    if(opt->trace)
+    {
+      ralg_trace_record r;
+      r.iter = iter;
+      r.nr_evals = j;
+      r.nr_matrix_reset = nr_matrix_reset;
+      r.reserved = 0;
+      r.f_val = f_val;
+      r.step = step;
+      r.norm = d_var;
+      r.diff = step_diff;
+      r.t_callback = t_callback;
+      r.t_blas = std::chrono::duration<double>(trace_clock::now() - t_iter).count() - t_callback - t_output;
+      opt->trace->push(r);
+    }
+
     if(iter > opt->itermax)
     {
       printf("max_iter reached\n");
       break;
     }
+
+    if(cb_iter && step > opt->stepmin)
+    {
+      state.iter = iter;
+      state.nr_matrix_reset = nr_matrix_reset;
+      state.step = step;
+      state.f_val = f_val;
+      state.f_optimal = f_optimal;
+      state.evaluated = true;
+      if(!cb_iter(state))
+      {
+        printf("stopped by caller on iter %d\n", iter);
+        break;
+      }
+    }
   } while(step > opt->stepmin);
   if(step <= opt->stepmin)
   {
@@ -210,6 +415,16 @@ double ralg(const ralg_options* opt,
   printf("Time stats : init %.1lf, compute %.1lf, total %.1lf\n", difftime(t_inited, t_started), difftime(t_done, t_inited), difftime(t_done, t_started));
 
   //memory release
+  for(i = 0; i < nr_ws; ++i)
+  {
+    free(ws_x[i]);
+    free(ws_grad[i]);
+  }
+  free(ws_x);
+  free(ws_grad);
+  free(ws_step);
+  free(ws_f);
+  free(ws_ok);
   free(tmp2);
   free(tmp);
   free(grad);
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <random>
+
+#include "districting/assign.hpp"
+#include "districting/common.hpp"
+
+using namespace std;
+
+namespace {
+
+// nodes on a line at random positions, w[i][j] = population[i] * d(i,j)^2 as in the Hess model
+void line_instance(int n, unsigned int seed, vector<vector<double>>& w, vector<int>& population)
+{
+  mt19937 gen(seed);
+  uniform_real_distribution<double> pos(0., 10.);
+  uniform_int_distribution<int> pop(1, 9);
+  vector<double> x(n);
+  population.resize(n);
+  for (int i = 0; i < n; ++i)
+  {
+    x[i] = pos(gen);
+    population[i] = pop(gen);
+  }
+  w.assign(n, vector<double>(n));
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      w[i][j] = population[i] * (x[i] - x[j]) * (x[i] - x[j]);
+}
+
+// district populations of [assignment] in [L, U], every node assigned to a center, centers to themselves
+bool feasible(const vector<int>& population, int L, int U, const vector<int>& centers, const vector<int>& assignment)
+{
+  int n = population.size();
+  vector<int> load(n, 0);
+  vector<char> is_center(n, 0);
+  for (int c : centers)
+    is_center[c] = 1;
+  for (int i = 0; i < n; ++i)
+  {
+    if (assignment[i] < 0 || assignment[i] >= n || !is_center[assignment[i]])
+      return false;
+    if (is_center[i] && assignment[i] != i)
+      return false;
+    load[assignment[i]] += population[i];
+  }
+  for (int c : centers)
+    if (load[c] < L || load[c] > U)
+      return false;
+  return true;
+}
+
+// optimum over all k^(n-k) assignments, MYINFINITY if none is feasible
+double brute_force(const vector<vector<double>>& w, const vector<int>& population, int L, int U, const vector<int>& centers)
+{
+  int n = population.size();
+  int k = centers.size();
+  vector<int> assignment(n, -1);
+  vector<int> free_nodes;
+  for (int c : centers)
+    assignment[c] = c;
+  for (int i = 0; i < n; ++i)
+    if (assignment[i] < 0)
+      free_nodes.push_back(i);
+  vector<int> choice(free_nodes.size(), 0);
+  double best = MYINFINITY;
+  while (true)
+  {
+    for (size_t t = 0; t < free_nodes.size(); ++t)
+      assignment[free_nodes[t]] = centers[choice[t]];
+    if (feasible(population, L, U, centers, assignment))
+    {
+      double obj = 0.;
+      for (int i = 0; i < n; ++i)
+        obj += w[i][assignment[i]];
+      best = min(best, obj);
+    }
+    size_t t = 0;
+    while (t < choice.size() && ++choice[t] == k)
+      choice[t++] = 0;
+    if (t == choice.size())
+      break;
+  }
+  return best;
+}
+
+double objective(const vector<vector<double>>& w, const vector<int>& assignment)
+{
+  double obj = 0.;
+  for (size_t i = 0; i < assignment.size(); ++i)
+    obj += w[i][assignment[i]];
+  return obj;
+}
+
+}
+
+TEST(AssignmentSolver, OptimalWithoutBindingBounds) {
+  // bounds that no assignment can violate: every node goes to its cheapest center
+  for (unsigned int seed = 0; seed < 20; ++seed)
+  {
+    int n = 9;
+    vector<vector<double>> w;
+    vector<int> population;
+    line_instance(n, seed, w, population);
+    vector<int> centers = {0, 1, 2};
+
+    assignment_solver solver(w, population, 0, 1000);
+    vector<int> assignment;
+    double obj = solver.solve(centers, assignment);
+    double opt = brute_force(w, population, 0, 1000, centers);
+    ASSERT_LT(obj, MYINFINITY) << "seed " << seed;
+    EXPECT_TRUE(feasible(population, 0, 1000, centers, assignment)) << "seed " << seed;
+    EXPECT_NEAR(obj, opt, 1e-9 * (1. + opt)) << "seed " << seed;
+    EXPECT_NEAR(solver.lp_bound, opt, 1e-9 * (1. + opt)) << "seed " << seed;
+  }
+}
+
+TEST(AssignmentSolver, FeasibleAndBoundedByBruteForce) {
+  // the LP is rounded and repaired, so the assignment is feasible but need not be optimal;
+  // the LP bound and the objective enclose the optimum
+  for (unsigned int seed = 0; seed < 40; ++seed)
+  {
+    int n = 9;
+    vector<vector<double>> w;
+    vector<int> population;
+    line_instance(n, seed, w, population);
+    int total = 0;
+    for (int p : population)
+      total += p;
+    vector<int> centers = {0, 1, 2};
+    int L = total / 3 - 4, U = total / 3 + 4;
+
+    assignment_solver solver(w, population, L, U);
+    vector<int> assignment;
+    double obj = solver.solve(centers, assignment);
+    double opt = brute_force(w, population, L, U, centers);
+    if (opt >= MYINFINITY)
+    {
+      EXPECT_EQ(obj, MYINFINITY) << "seed " << seed;
+      continue;
+    }
+    ASSERT_LT(obj, MYINFINITY) << "seed " << seed;
+    EXPECT_TRUE(feasible(population, L, U, centers, assignment)) << "seed " << seed;
+    EXPECT_DOUBLE_EQ(obj, objective(w, assignment)) << "seed " << seed;
+    EXPECT_GE(obj, opt - 1e-9 * (1. + opt)) << "seed " << seed;
+    EXPECT_LE(solver.lp_bound, opt + 1e-9 * (1. + opt)) << "seed " << seed;
+  }
+}
+
+TEST(AssignmentSolver, TightWindowNeedsSwap) {
+  // the cheap assignment puts 0 + 5 + 5 on center 0 and 0 + 4 + 4 on center 1; with L = U = 9 no single
+  // move balances the districts (every node weighs 4 or 5), only exchanging a 5 for a 4 does
+  vector<int> population = {0, 0, 5, 5, 4, 4};
+  vector<double> x = {0., 10., 1., 2., 8., 9.};
+  int n = population.size();
+  vector<vector<double>> w(n, vector<double>(n));
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+      w[i][j] = population[i] * (x[i] - x[j]) * (x[i] - x[j]);
+  vector<int> centers = {0, 1};
+
+  assignment_solver solver(w, population, 9, 9);
+  vector<int> assignment;
+  double obj = solver.solve(centers, assignment);
+  ASSERT_LT(obj, MYINFINITY);
+  EXPECT_TRUE(feasible(population, 9, 9, centers, assignment));
+  EXPECT_NEAR(obj, brute_force(w, population, 9, 9, centers), 1e-9);
+}
+
+TEST(AssignmentSolver, InfeasibleReturnsInfinity) {
+  // 3 + 3 + 3 cannot be split into two districts in [4, 5]
+  vector<int> population = {3, 3, 3};
+  int n = population.size();
+  vector<vector<double>> w(n, vector<double>(n, 1.));
+  for (int i = 0; i < n; ++i)
+    w[i][i] = 0.;
+  assignment_solver solver(w, population, 4, 5);
+  vector<int> assignment;
+  EXPECT_EQ(solver.solve({0, 1}, assignment), MYINFINITY);
+
+  // a center heavier than U
+  vector<int> heavy = {7, 1, 1};
+  assignment_solver heavy_solver(w, heavy, 1, 5);
+  EXPECT_EQ(heavy_solver.solve({0, 1}, assignment), MYINFINITY);
+}
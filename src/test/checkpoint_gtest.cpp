@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+#include "districting/io.hpp"
+#include "districting/ralg.hpp"
+
+using namespace std;
+
+namespace {
+
+// ralg_state with its own buffers for [dim] coordinates
+struct owned_state
+{
+  vector<double> xk, grad, res, B;
+  ralg_state st;
+  owned_state(unsigned int dim) : xk(dim), grad(dim), res(dim), B(static_cast<size_t>(dim) * dim)
+  {
+    st = ralg_state{0, 0, 0., 0., 0., xk.data(), grad.data(), res.data(), B.data(), false};
+  }
+};
+
+void fill_state(owned_state& s, double seed)
+{
+  s.st.iter = 17;
+  s.st.nr_matrix_reset = 2;
+  s.st.step = 0.25 * seed;
+  s.st.f_val = -3. * seed;
+  s.st.f_optimal = -2.5 * seed;
+  for (size_t i = 0; i < s.xk.size(); ++i)
+  {
+    s.xk[i] = seed + i;
+    s.grad[i] = seed - 0.5 * i;
+    s.res[i] = seed * i;
+  }
+  for (size_t i = 0; i < s.B.size(); ++i)
+    s.B[i] = seed / (i + 1.);
+}
+
+void expect_same(const owned_state& a, const owned_state& b)
+{
+  EXPECT_EQ(a.st.iter, b.st.iter);
+  EXPECT_EQ(a.st.nr_matrix_reset, b.st.nr_matrix_reset);
+  EXPECT_EQ(a.st.step, b.st.step);
+  EXPECT_EQ(a.st.f_val, b.st.f_val);
+  EXPECT_EQ(a.st.f_optimal, b.st.f_optimal);
+  EXPECT_EQ(a.xk, b.xk);
+  EXPECT_EQ(a.grad, b.grad);
+  EXPECT_EQ(a.res, b.res);
+  EXPECT_EQ(a.B, b.B);
+}
+
+class LagrangeCheckpoint : public ::testing::Test
+{
+protected:
+  // multipliers of n nodes, 3n in the full dimension as in the Lagrangian
+  const unsigned int n = 4;
+  string fname;
+  vector<double> base;
+  vector<vector<double>> LB1;
+  void SetUp() override
+  {
+    fname = ::testing::TempDir() + "lagrange_checkpoint_gtest.bin";
+    base.resize(3 * n);
+    for (size_t i = 0; i < base.size(); ++i)
+      base[i] = 0.1 * i;
+    LB1.assign(n, vector<double>(n));
+    for (unsigned int i = 0; i < n; ++i)
+      for (unsigned int j = 0; j < n; ++j)
+        LB1[i][j] = i * 10. + j;
+  }
+  void TearDown() override { remove(fname.c_str()); }
+};
+
+}
+
+TEST_F(LagrangeCheckpoint, RoundTrip) {
+  vector<int> active;
+  for (unsigned int i = 0; i < 3 * n; ++i)
+    active.push_back(i);
+  owned_state out(active.size());
+  fill_state(out, 1.5);
+  ASSERT_TRUE(dump_lagrange_checkpoint(fname.c_str(), out.st, active, base, 42.5, LB1));
+
+  vector<int> peeked;
+  ASSERT_TRUE(peek_lagrange_checkpoint(fname.c_str(), n, peeked));
+  EXPECT_EQ(peeked, active);
+
+  owned_state in(peeked.size());
+  vector<double> base_in(base.size());
+  vector<vector<double>> LB1_in(n, vector<double>(n));
+  double LB = 0.;
+  ASSERT_TRUE(read_lagrange_checkpoint(fname.c_str(), in.st, peeked, base_in, LB, LB1_in));
+  expect_same(out, in);
+  EXPECT_TRUE(in.st.evaluated);
+  EXPECT_EQ(LB, 42.5);
+  EXPECT_EQ(base_in, base);
+  EXPECT_EQ(LB1_in, LB1);
+}
+
+TEST_F(LagrangeCheckpoint, RoundTripAfterShrink) {
+  // centers ruled out: only some coordinates remain active, the rest stays in base
+  vector<int> active = {1, 4, 5, 9, 11};
+  base[4] = -7.;
+  owned_state out(active.size());
+  fill_state(out, -0.75);
+  ASSERT_TRUE(dump_lagrange_checkpoint(fname.c_str(), out.st, active, base, -1., LB1));
+
+  vector<int> peeked;
+  ASSERT_TRUE(peek_lagrange_checkpoint(fname.c_str(), n, peeked));
+  EXPECT_EQ(peeked, active);
+
+  owned_state in(peeked.size());
+  vector<double> base_in(base.size());
+  vector<vector<double>> LB1_in(n, vector<double>(n));
+  double LB = 0.;
+  ASSERT_TRUE(read_lagrange_checkpoint(fname.c_str(), in.st, peeked, base_in, LB, LB1_in));
+  expect_same(out, in);
+  EXPECT_EQ(LB, -1.);
+  EXPECT_EQ(base_in, base);
+  EXPECT_EQ(LB1_in, LB1);
+
+  // an active set other than the stored one is rejected
+  vector<int> other = {1, 4, 5, 9, 10};
+  EXPECT_FALSE(read_lagrange_checkpoint(fname.c_str(), in.st, other, base_in, LB, LB1_in));
+}
+
+TEST_F(LagrangeCheckpoint, RejectsMismatch) {
+  vector<int> active = {0, 2};
+  owned_state out(active.size());
+  fill_state(out, 1.);
+  ASSERT_TRUE(dump_lagrange_checkpoint(fname.c_str(), out.st, active, base, 0., LB1));
+
+  vector<int> peeked;
+  EXPECT_FALSE(peek_lagrange_checkpoint(fname.c_str(), n + 1, peeked));
+  EXPECT_FALSE(peek_lagrange_checkpoint((fname + ".missing").c_str(), n, peeked));
+
+  // a truncated file is corrupted: keep the header and the active coordinates only
+  FILE* f = fopen(fname.c_str(), "rb");
+  ASSERT_NE(f, nullptr);
+  char head[24];
+  ASSERT_EQ(fread(head, 1, sizeof(head), f), sizeof(head));
+  fclose(f);
+  f = fopen(fname.c_str(), "wb");
+  ASSERT_NE(f, nullptr);
+  fwrite(head, 1, sizeof(head), f);
+  fclose(f);
+  owned_state in(active.size());
+  vector<double> base_in(base.size());
+  vector<vector<double>> LB1_in(n, vector<double>(n));
+  double LB = 0.;
+  EXPECT_FALSE(read_lagrange_checkpoint(fname.c_str(), in.st, active, base_in, LB, LB1_in));
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "districting/fixing.hpp"
+
+using namespace std;
+
+// three words per row, the last one holding 2 valid bits
+const int N = 130;
+
+TEST(FixingMatrix, StartsFree) {
+  fixing_matrix F(N);
+  EXPECT_EQ(F.size(), N);
+  EXPECT_EQ(F.nr_words(), 3u);
+  EXPECT_EQ(F.count_zero(), 0u);
+  EXPECT_EQ(F.count_one(), 0u);
+  for (int i = 0; i < N; ++i)
+    for (int j = 0; j < N; ++j)
+      ASSERT_TRUE(F.is_free(i, j));
+  // no bits past column n - 1 in the last word
+  EXPECT_EQ(F.free_word(0, 2), uint64_t(3));
+
+  fixing_matrix E;
+  EXPECT_EQ(E.size(), 0);
+  EXPECT_EQ(E.nr_words(), 0u);
+}
+
+TEST(FixingMatrix, ZeroAndOnePlanes) {
+  fixing_matrix F(N);
+  vector<int> cols = {0, 1, 63, 64, 65, 127, 128, 129};
+  for (int j : cols)
+  {
+    F.fix_zero(5, j);
+    F.fix_one(7, j);
+  }
+  EXPECT_EQ(F.count_zero(), cols.size());
+  EXPECT_EQ(F.count_one(), cols.size());
+  for (int j = 0; j < N; ++j)
+  {
+    bool fixed = find(cols.begin(), cols.end(), j) != cols.end();
+    EXPECT_EQ(F.is_zero(5, j), fixed) << j;
+    EXPECT_FALSE(F.is_one(5, j)) << j;
+    EXPECT_EQ(F.is_free(5, j), !fixed) << j;
+    EXPECT_EQ(F.is_one(7, j), fixed) << j;
+    EXPECT_FALSE(F.is_zero(7, j)) << j;
+    EXPECT_EQ(F.is_free(7, j), !fixed) << j;
+    // the neighbouring rows are untouched
+    EXPECT_TRUE(F.is_free(4, j) && F.is_free(6, j) && F.is_free(8, j)) << j;
+  }
+
+  F.resize(N);
+  EXPECT_EQ(F.count_zero(), 0u);
+  EXPECT_EQ(F.count_one(), 0u);
+}
+
+TEST(FixingMatrix, ForFreeAndForOneAcrossWords) {
+  fixing_matrix F(N);
+  vector<int> zeros = {0, 62, 63, 64, 100, 129};
+  vector<int> ones = {1, 63, 64, 127, 128};
+  for (int j : zeros)
+    F.fix_zero(3, j);
+  for (int j : ones)
+    F.fix_one(3, j);
+
+  vector<int> expected_free;
+  for (int j = 0; j < N; ++j)
+    if (find(zeros.begin(), zeros.end(), j) == zeros.end() && find(ones.begin(), ones.end(), j) == ones.end())
+      expected_free.push_back(j);
+  vector<int> free_cols;
+  F.for_free(3, [&](int j) { free_cols.push_back(j); });
+  EXPECT_EQ(free_cols, expected_free);
+
+  vector<int> one_cols;
+  F.for_one(3, [&](int j) { one_cols.push_back(j); });
+  EXPECT_EQ(one_cols, ones);
+
+  // a free row visits every column once, in order, and nothing past n - 1
+  free_cols.clear();
+  F.for_free(2, [&](int j) { free_cols.push_back(j); });
+  ASSERT_EQ(free_cols.size(), static_cast<size_t>(N));
+  for (int j = 0; j < N; ++j)
+    EXPECT_EQ(free_cols[j], j);
+  one_cols.clear();
+  F.for_one(2, [&](int j) { one_cols.push_back(j); });
+  EXPECT_TRUE(one_cols.empty());
+}
+
+TEST(FixingMatrix, RestrictColumns) {
+  fixing_matrix F(N);
+  F.fix_one(0, 10);
+  vector<int> columns = {2, 63, 64, 129};
+  F.restrict_columns(columns);
+  EXPECT_EQ(F.count_one(), 0u);
+  EXPECT_EQ(F.count_zero(), static_cast<size_t>(N) * (N - columns.size()));
+  for (int i : {0, 64, N - 1})
+  {
+    vector<int> free_cols;
+    F.for_free(i, [&](int j) { free_cols.push_back(j); });
+    EXPECT_EQ(free_cols, columns);
+    EXPECT_TRUE(F.is_zero(i, 10));
+  }
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <algorithm>
+
+#include "districting/common.hpp"
+
+using namespace std;
+
+TEST(VarIndex, MapsPairsAndBack) {
+  var_index h;
+  int n = 70;
+  vector<int> columns = {3, 0, 65, 40};
+  h.reset(n, columns);
+  EXPECT_EQ(h.size(), 0u);
+
+  // variables are numbered in the order they are added
+  vector<pair<int, int>> pairs;
+  for (int i = 0; i < n; i += 3)
+    for (int j : columns)
+      if ((i + j) % 2 == 0)
+        pairs.push_back({i, j});
+  for (size_t v = 0; v < pairs.size(); ++v)
+    EXPECT_EQ(h.add(pairs[v].first, pairs[v].second), static_cast<int>(v));
+  ASSERT_EQ(h.size(), pairs.size());
+
+  for (size_t v = 0; v < pairs.size(); ++v)
+  {
+    int i = pairs[v].first, j = pairs[v].second;
+    EXPECT_TRUE(h.has(i, j));
+    EXPECT_EQ(h(i, j), static_cast<int>(v));
+    EXPECT_EQ(h.row(v), i);
+    EXPECT_EQ(h.column(v), j);
+    EXPECT_EQ(h(h.row(v), h.column(v)), static_cast<int>(v));
+  }
+
+  for (int i = 0; i < n; ++i)
+    for (int j = 0; j < n; ++j)
+    {
+      bool added = find(pairs.begin(), pairs.end(), make_pair(i, j)) != pairs.end();
+      EXPECT_EQ(h.has(i, j), added) << i << " " << j;
+    }
+}
+
+TEST(VarIndex, ResetForgetsVariables) {
+  var_index h;
+  h.reset(5, {1, 2});
+  h.add(0, 1);
+  h.add(4, 2);
+  h.reset(5, {2, 4});
+  EXPECT_EQ(h.size(), 0u);
+  EXPECT_FALSE(h.has(0, 1));
+  EXPECT_FALSE(h.has(4, 2));
+  EXPECT_EQ(h.add(4, 4), 0);
+  EXPECT_TRUE(h.has(4, 4));
+  EXPECT_EQ(h.row(0), 4);
+  EXPECT_EQ(h.column(0), 4);
+}